@@ -0,0 +1,179 @@
+#include "dimacs.hh"
+
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "utility.hh"
+
+namespace DIMACS {
+struct Chunk {
+    const char *begin;
+    const char *end;
+    int narc;   // Number of arc lines
+    int first;  // Edge index of the first arc line
+};
+
+inline void fail(const char *path, const char *msg) {
+    fprintf(stderr, "%s: %s\n", path, msg);
+    exit(EXIT_FAILURE);
+}
+
+inline const char *skipLine(const char *p, const char *end) {
+    const char *q = (const char *)memchr(p, '\n', end - p);
+    return q ? q + 1 : end;
+}
+
+#define PARSE_OVERFLOW -2
+
+// *x is -1 if there is no number and PARSE_OVERFLOW if it does not fit an int
+inline const char *parseInt(const char *p, const char *end, int *x) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    int v = 0;
+    bool overflow = false;
+    const char *q = p;
+    while (q < end && (unsigned)(*q - '0') < 10) {
+        int d = *q - '0';
+        overflow |= v > (INT_MAX - d) / 10;
+        v = overflow ? 0 : v * 10 + d;
+        q++;
+    }
+    *x = q == p ? -1 : overflow ? PARSE_OVERFLOW : v;
+    return q;
+}
+
+// Aligns chunk boundaries to line starts
+inline const char *lineStart(const char *base, const char *p, const char *end) {
+    if (p == base)
+        return p;
+    return p[-1] == '\n' ? p : skipLine(p, end);
+}
+}  // namespace DIMACS
+
+void loadDimacs(const char *path, int *V, int *S, int *T, ResidualGraph *csr) {
+    using namespace DIMACS;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        fail(path, strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        fail(path, strerror(errno));
+    size_t size = st.st_size;
+    const char *base = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED)
+        fail(path, strerror(errno));
+    madvise((void *)base, size, MADV_WILLNEED);
+    const char *end = base + size;
+
+    // Problem and node lines, they precede the arcs
+    int nv = -1, ne = -1, s = -1, t = -1;
+    const char *p = base;
+    while (p < end && *p != 'a') {
+        if (*p == 'p') {
+            p = (const char *)memchr(p, 'x', end - p);  // "p max"
+            if (!p)
+                fail(path, "bad problem line");
+            p = parseInt(p + 1, end, &nv);
+            p = parseInt(p, end, &ne);
+            if (nv == PARSE_OVERFLOW || ne == PARSE_OVERFLOW)
+                fail(path, "problem line number does not fit an int");
+        } else if (*p == 'n') {
+            int id;
+            p = parseInt(p + 1, end, &id);
+            if (id == PARSE_OVERFLOW)
+                fail(path, "node line number does not fit an int");
+            while (p < end && *p == ' ')
+                p++;
+            if (p < end && *p == 's')
+                s = id - 1;
+            else if (p < end && *p == 't')
+                t = id - 1;
+        }
+        p = skipLine(p, end);
+    }
+    if (nv <= 0 || ne < 0 || s < 0 || t < 0 || s >= nv || t >= nv)
+        fail(path, "missing or invalid problem/node lines");
+    if (s == t)
+        fail(path, "source equals sink");
+
+    // Split arcs into line-aligned chunks and count arc lines
+    int nchunk = omp_get_max_threads() * 4;
+    Chunk *chunk = (Chunk *)malloc(sizeof(Chunk) * nchunk);
+    for (int c = 0; c < nchunk; c++) {
+        chunk[c].begin = lineStart(base, p + (end - p) * c / nchunk, end);
+    }
+    for (int c = 0; c < nchunk; c++) {
+        chunk[c].end = c + 1 < nchunk ? chunk[c + 1].begin : end;
+        if (chunk[c].end < chunk[c].begin)
+            chunk[c].end = chunk[c].begin;
+    }
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < nchunk; c++) {
+        int n = 0;
+        for (const char *q = chunk[c].begin; q < chunk[c].end; q = skipLine(q, chunk[c].end)) {
+            n += *q == 'a';
+        }
+        chunk[c].narc = n;
+    }
+    long long narc = 0;
+    for (int c = 0; c < nchunk; c++) {
+        chunk[c].first = narc;
+        narc += chunk[c].narc;
+    }
+    if (narc != ne)
+        fail(path, "arc count does not match problem line");
+    if (ne > MAX_EDGES)
+        fail(path, "too many arcs");
+    int E = ne;
+
+    // Parse arcs in file order
+    int *tail = (int *)malloc(sizeof(int) * E);
+    int *head = (int *)malloc(sizeof(int) * E);
+    int *cap = (int *)malloc(sizeof(int) * E);
+    int bad = 0;
+    int overflow = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(| : bad, overflow)
+    for (int c = 0; c < nchunk; c++) {
+        int i = chunk[c].first;
+        for (const char *q = chunk[c].begin; q < chunk[c].end; q = skipLine(q, chunk[c].end)) {
+            if (*q != 'a')
+                continue;
+            int u, v, w;
+            q = parseInt(q + 1, chunk[c].end, &u);
+            q = parseInt(q, chunk[c].end, &v);
+            q = parseInt(q, chunk[c].end, &w);
+            overflow |= u == PARSE_OVERFLOW || v == PARSE_OVERFLOW || w == PARSE_OVERFLOW;
+            bad |= u < 1 || u > nv || v < 1 || v > nv || w < 0;
+            tail[i] = u - 1;
+            head[i] = v - 1;
+            cap[i] = w;
+            i++;
+        }
+    }
+    if (overflow)
+        fail(path, "arc line number does not fit an int");
+    if (bad)
+        fail(path, "bad arc line");
+
+    munmap((void *)base, size);
+    close(fd);
+
+    *V = nv;
+    *S = s;
+    *T = t;
+    buildResidualGraph(csr, nv, E, tail, head, cap);
+    DEBUG_PRINT("Loaded %s: V = %d, E = %d\n", path, nv, E);
+
+    free(chunk);
+    free(tail);
+    free(head);
+    free(cap);
+}
@@ -0,0 +1,10 @@
+#ifndef DIMACS_LOADER
+#define DIMACS_LOADER
+
+#include "residual-graph.hh"
+
+// Loads a DIMACS max-flow file ("p max V E", "n id s|t", "a u v cap").
+// The file is memory-mapped and arcs are parsed in parallel chunks.
+void loadDimacs(const char *path, int *V, int *S, int *T, ResidualGraph *csr);
+
+#endif  // DIMACS_LOADER
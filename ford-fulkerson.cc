@@ -6,7 +6,6 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <queue>
 #include <vector>
 
 #include "graph.hh"
@@ -18,12 +17,14 @@ struct Data {
     int S;
     int T;
     int ncpus;
-    int *capacity;
-    int *edge;
-    int *nedge;
+    const ResidualGraph *csr;
     int *residual;
-    int *rpath;
+    int *rpath;  // Arc entering each vertex on the augmenting path
     bool *visited;
+    int *queue;  // BFS queue
+    int maxV;    // Vertices and edges the arena is carved for
+    int maxE;
+    Arena arena;
 };
 
 inline int min(int x, int y) {
@@ -34,37 +35,38 @@ inline int min(int x, int y) {
 }
 
 inline int getcf(Data *data) {
-    int V = data->V;
+    const ResidualGraph *csr = data->csr;
     int S = data->S;
     int T = data->T;
     int cf = 0x7fffffff;
-    for (int u = data->rpath[T], v = T; v != S; u = data->rpath[v = u]) {
-        cf = min(cf, data->residual[u * V + v]);
+    for (int v = T; v != S; v = csr->head[csr->rev[data->rpath[v]]]) {
+        cf = min(cf, data->residual[data->rpath[v]]);
     }
     return cf;
 }
 
 inline int getPath(Data *data) {
+    const ResidualGraph *csr = data->csr;
     int V = data->V;
     int S = data->S;
     int T = data->T;
-    std::queue<int> que;
+    int *que = data->queue;
+    int front = 0, back = 0;
     int u, v;
 
     memset(data->visited, false, sizeof(bool) * V);
-    que.emplace(S);
-    data->rpath[S] = S;
+    que[back++] = S;
+    data->rpath[S] = -1;
     data->visited[S] = true;
 
-    while (!que.empty()) {
-        u = que.front();
-        que.pop();
-        for (int i = 0; i < data->nedge[u]; i++) {
-            v = data->edge[u * V + i];
-            if (!data->visited[v] && data->residual[u * V + v] > 0) {
-                data->rpath[v] = u;
+    while (front < back) {
+        u = que[front++];
+        for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+            v = csr->head[a];
+            if (!data->visited[v] && data->residual[a] > 0) {
+                data->rpath[v] = a;
                 data->visited[v] = true;
-                que.emplace(v);
+                que[back++] = v;
                 if (v == T) {
                     return getcf(data);
                 }
@@ -74,57 +76,70 @@ inline int getPath(Data *data) {
 
     return 0;
 }
+
+inline void carve(Data *data, Arena *arena, int V, int E) {
+    data->residual = (int *)arenaAlloc(arena, sizeof(int) * 2 * E);
+    data->rpath = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->visited = (bool *)arenaAlloc(arena, sizeof(bool) * V);
+    data->queue = (int *)arenaAlloc(arena, sizeof(int) * V);
+}
+
+// Grows the arena to fit V vertices and E edges, kept as is if it already does
+inline void reserve(Data *data, int V, int E) {
+    if (data->arena.base && V <= data->maxV && E <= data->maxE)
+        return;
+    V = V > data->maxV ? V : data->maxV;
+    E = E > data->maxE ? E : data->maxE;
+    arenaFree(&data->arena);
+    carve(data, &data->arena, V, E);
+    arenaCommit(&data->arena);
+    carve(data, &data->arena, V, E);
+    data->maxV = V;
+    data->maxE = E;
+}
 }  // namespace FF
+using namespace FF;
+
+struct FordFulkersonSession {
+    Data *data;
+};
+
+FordFulkersonSession *openFordFulkerson(int V, int E) {
+    FordFulkersonSession *session = (FordFulkersonSession *)malloc(sizeof(FordFulkersonSession));
+    Data *data = session->data = (Data *)malloc(sizeof(Data));
+    memset(data, 0, sizeof(Data));
+    reserve(data, V, E);
+    return session;
+}
 
-void FordFulkerson(Graph *graph, int *flow) {
-    using namespace FF;
-    Data *data = (Data *)malloc(sizeof(Data));
-    int V = data->V = graph->V;
+int solveFordFulkerson(FordFulkersonSession *session, Graph *graph, int *flow) {
+    Data *data = session->data;
+    reserve(data, graph->V, graph->E);
+    const ResidualGraph *csr = data->csr = &graph->csr;
+    data->V = graph->V;
     int S = data->S = graph->S;
     int T = data->T = graph->T;
-    data->capacity = (int *)malloc(V * V * sizeof(int));
-    data->edge = (int *)malloc(V * V * sizeof(int));
-    data->nedge = (int *)malloc(V * sizeof(int));
-    data->residual = (int *)malloc(V * V * sizeof(int));
-    data->rpath = (int *)malloc(V * sizeof(int));
-    data->visited = (bool *)malloc(V * sizeof(bool));
     int f, cf;
 
-    memset(data->capacity, 0, V * V * sizeof(int));
-
-    for (int u = 0; u < V; u++) {
-        data->nedge[u] = graph->edge[u].size();
-        for (int i = 0; i < data->nedge[u]; i++) {
-            int v = graph->edge[u][i].first;
-            data->edge[u * V + i] = v;
-            data->capacity[u * V + v] = graph->edge[u][i].second;
-        }
-    }
-    for (int u = 0; u < V; u++) {
-        for (int v = 0; v < V; v++) {
-            data->residual[u * V + v] = data->capacity[u * V + v];
-        }
-    }
+    memcpy(data->residual, csr->cap, 2 * csr->E * sizeof(int));
 
     for (f = 0; (cf = getPath(data)); f += cf) {
-        for (int u = data->rpath[T], v = T; v != S; u = data->rpath[v = u]) {
-            data->residual[u * V + v] -= cf;
-            data->residual[v * V + u] += cf;
+        for (int v = T; v != S; v = csr->head[csr->rev[data->rpath[v]]]) {
+            int a = data->rpath[v];
+            data->residual[a] -= cf;
+            data->residual[csr->rev[a]] += cf;
         }
     }
 
-    for (int u = 0; u < V; u++) {
-        for (int i = 0; i < data->nedge[u]; i++) {
-            int v = data->edge[u * V + i];
-            flow[u * V + v] = data->capacity[u * V + v] - data->residual[u * V + v];
-        }
+    for (int i = 0; i < csr->E; i++) {
+        int a = csr->arc[i];
+        flow[i] = csr->cap[a] - data->residual[a];
     }
+    return f;
+}
 
-    free(data->capacity);
-    free(data->edge);
-    free(data->nedge);
-    free(data->residual);
-    free(data->rpath);
-    free(data->visited);
-    free(data);
-}
\ No newline at end of file
+void closeFordFulkerson(FordFulkersonSession *session) {
+    arenaFree(&session->data->arena);
+    free(session->data);
+    free(session);
+}
@@ -3,5 +3,10 @@
 
 #include "graph.hh"
 
-void FordFulkerson(Graph *graph, int *flow);
+// Buffers for graphs of up to V vertices and E edges kept between solves,
+// a larger graph grows them. A solve returns the max flow value.
+struct FordFulkersonSession;
+FordFulkersonSession *openFordFulkerson(int V, int E);
+int solveFordFulkerson(FordFulkersonSession *session, Graph *graph, int *flow);
+void closeFordFulkerson(FordFulkersonSession *session);
 #endif  // FORD_FULKERSON
\ No newline at end of file
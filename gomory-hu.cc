@@ -0,0 +1,204 @@
+#include "gomory-hu.hh"
+
+#include <omp.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "push-relabel.hh"
+#include "utility.hh"
+
+namespace GH {
+inline int min(int x, int y) {
+    if (x < y)
+        return x;
+    else
+        return y;
+}
+
+// Every edge in both directions with its full capacity, self loops dropped
+inline void undirected(const ResidualGraph *csr, ResidualGraph *ucsr) {
+    int *tail = (int *)malloc(sizeof(int) * 2 * csr->E);
+    int *head = (int *)malloc(sizeof(int) * 2 * csr->E);
+    int *cap = (int *)malloc(sizeof(int) * 2 * csr->E);
+    int M = 0;
+    for (int i = 0; i < csr->E; i++) {
+        int a = csr->arc[i];
+        int u = csr->head[csr->rev[a]];
+        int v = csr->head[a];
+        if (u == v)
+            continue;
+        tail[M] = u;
+        head[M] = v;
+        cap[M++] = csr->cap[a];
+        tail[M] = v;
+        head[M] = u;
+        cap[M++] = csr->cap[a];
+    }
+    memset(ucsr, 0, sizeof(ResidualGraph));
+    buildResidualGraph(ucsr, csr->V, M, tail, head, cap);
+    free(tail);
+    free(head);
+    free(cap);
+}
+
+// Depths and binary lifting tables for path minimum queries
+inline void buildLifting(GomoryHuTree *tree) {
+    int V = tree->V;
+    tree->depth = (int *)malloc(sizeof(int) * V);
+    for (int u = 0; u < V; u++) {
+        tree->depth[u] = tree->parent[u] == -1 ? 0 : -1;
+    }
+    std::vector<int> path;
+    for (int u = 0; u < V; u++) {
+        int x = u;
+        while (tree->depth[x] == -1) {
+            path.push_back(x);
+            x = tree->parent[x];
+        }
+        for (int d = tree->depth[x]; path.size(); path.pop_back()) {
+            tree->depth[path.back()] = ++d;
+        }
+    }
+
+    tree->levels = 1;
+    while ((1 << tree->levels) < V)
+        tree->levels++;
+    tree->up = (int *)malloc(sizeof(int) * tree->levels * V);
+    tree->low = (int *)malloc(sizeof(int) * tree->levels * V);
+    for (int u = 0; u < V; u++) {
+        tree->up[u] = tree->parent[u] == -1 ? u : tree->parent[u];
+        tree->low[u] = tree->parent[u] == -1 ? INT_MAX : tree->value[u];
+    }
+    for (int k = 1; k < tree->levels; k++) {
+        int *up = tree->up + (k - 1) * V;
+        int *low = tree->low + (k - 1) * V;
+        for (int u = 0; u < V; u++) {
+            tree->up[k * V + u] = up[up[u]];
+            tree->low[k * V + u] = min(low[u], low[up[u]]);
+        }
+    }
+}
+}  // namespace GH
+using namespace GH;
+
+// Gusfield, "Very simple methods for all pairs network flow analysis". The cut
+// for s is taken against t = parent[s], and committing it may re-parent later
+// vertices, so cuts run speculatively in a window ahead of the commit point and
+// are only committed in order while parent[s] is still the t they used. The
+// tree is the same for any number of threads.
+void GomoryHu(Graph *graph, GomoryHuTree *tree) {
+    int V = tree->V = graph->V;
+    int ncpus = graph->ncpus;
+    int window = 2 * ncpus;
+    tree->parent = (int *)malloc(sizeof(int) * V);
+    tree->value = (int *)malloc(sizeof(int) * V);
+    int *used = (int *)malloc(sizeof(int) * V);  // t the stored cut of s was taken against
+    int *cutValue = (int *)malloc(sizeof(int) * V);
+    char *side = (char *)malloc(sizeof(char) * window * V);
+    for (int u = 0; u < V; u++) {
+        tree->parent[u] = u == 0 ? -1 : 0;
+        tree->value[u] = 0;
+        used[u] = -1;
+    }
+
+    ResidualGraph ucsr;
+    undirected(&graph->csr, &ucsr);
+    // One set of solver buffers per worker, reused for every cut it runs
+    PushRelabelSession **session = (PushRelabelSession **)malloc(sizeof(PushRelabelSession *) * ncpus);
+    for (int tid = 0; tid < ncpus; tid++) {
+        session[tid] = openMinCut(&ucsr, 1, graph->qtype);
+    }
+
+    for (int next = 1; next < V;) {
+        int end = next + window < V ? next + window : V;
+#pragma omp parallel for num_threads(ncpus) schedule(dynamic, 1)
+        for (int s = next; s < end; s++) {
+            int t = tree->parent[s];
+            if (used[s] != t) {
+                cutValue[s] = solveMinCut(session[omp_get_thread_num()], s, t, side + (size_t)(s % window) * V);
+                used[s] = t;
+            }
+        }
+        for (; next < end && used[next] == tree->parent[next]; next++) {
+            int s = next;
+            int t = tree->parent[s];
+            const char *X = side + (size_t)(s % window) * V;
+            tree->value[s] = cutValue[s];
+            for (int i = 0; i < V; i++) {
+                if (i != s && X[i] && tree->parent[i] == t)
+                    tree->parent[i] = s;
+            }
+            if (tree->parent[t] != -1 && X[tree->parent[t]]) {
+                tree->parent[s] = tree->parent[t];
+                tree->parent[t] = s;
+                tree->value[s] = tree->value[t];
+                tree->value[t] = cutValue[s];
+            }
+        }
+    }
+
+    buildLifting(tree);
+
+    for (int tid = 0; tid < ncpus; tid++) {
+        closePushRelabel(session[tid]);
+    }
+    free(session);
+    freeResidualGraph(&ucsr);
+    free(used);
+    free(cutValue);
+    free(side);
+}
+
+int queryGomoryHu(const GomoryHuTree *tree, int u, int v) {
+    int V = tree->V;
+    int best = INT_MAX;
+    if (tree->depth[u] < tree->depth[v]) {
+        int tmp = u;
+        u = v;
+        v = tmp;
+    }
+    for (int k = 0, diff = tree->depth[u] - tree->depth[v]; diff > 0; k++, diff >>= 1) {
+        if (diff & 1) {
+            best = min(best, tree->low[k * V + u]);
+            u = tree->up[k * V + u];
+        }
+    }
+    if (u == v)
+        return best;
+    for (int k = tree->levels - 1; k >= 0; k--) {
+        if (tree->up[k * V + u] != tree->up[k * V + v]) {
+            best = min(best, min(tree->low[k * V + u], tree->low[k * V + v]));
+            u = tree->up[k * V + u];
+            v = tree->up[k * V + v];
+        }
+    }
+    return min(best, min(tree->low[u], tree->low[v]));
+}
+
+void saveGomoryHu(const char *path, const GomoryHuTree *tree) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    for (int u = 0; u < tree->V; u++) {
+        if (tree->parent[u] != -1)
+            fprintf(fp, "%d %d %d\n", u, tree->parent[u], tree->value[u]);
+    }
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "%s: write failed\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void freeGomoryHu(GomoryHuTree *tree) {
+    free(tree->parent);
+    free(tree->value);
+    free(tree->depth);
+    free(tree->up);
+    free(tree->low);
+}
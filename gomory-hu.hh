@@ -0,0 +1,26 @@
+#ifndef GOMORY_HU
+#define GOMORY_HU
+
+#include "graph.hh"
+
+// Gomory-Hu tree of the graph read as undirected. The tree edge (u, parent[u])
+// has weight value[u], the root 0 has parent -1. The min u-v cut is the
+// smallest weight on the tree path between u and v.
+struct GomoryHuTree {
+    int V;
+    int *parent;
+    int *value;
+    int *depth;
+    int levels;  // Rows of up and low
+    int *up;     // up[k * V + u] is the 2^k-th ancestor of u, the root maps to itself
+    int *low;    // low[k * V + u] is the smallest weight on the way there
+};
+
+// Gusfield's algorithm, the V - 1 max flows run concurrently on ncpus workers
+void GomoryHu(Graph *graph, GomoryHuTree *tree);
+// Min u-v cut value by a path minimum over the tree, O(log V)
+int queryGomoryHu(const GomoryHuTree *tree, int u, int v);
+// One "u parent value" line per tree edge
+void saveGomoryHu(const char *path, const GomoryHuTree *tree);
+void freeGomoryHu(GomoryHuTree *tree);
+#endif  // GOMORY_HU
@@ -1,108 +1,388 @@
 #include "graph.hh"
 
 #include <omp.h>
+#include <unistd.h>
 
 #include <cassert>
+#include <cerrno>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <ctime>
 #include <queue>
 #include <vector>
 
+#include "dimacs.hh"
+#include "queue.hh"
+#include "snapshot.hh"
+
+// Usage: main [-c] [-p] [-m method] [-q qtype] [-l spin|mutex] [-g oneway,acyclic|none] [-o out.snap]
+//             [-r repeats] [-u rounds] [-a out.tree] [-s out.json] [-t out.json] [-k out.cut] V D,
+//             or the same options with -f file.max|file.snap
+// -q, -l and -g default to the QTYPE, SPINLOCK, GRAPH_ONE_WAY and GRAPH_ACYCLIC build flags,
+// -s needs TIMING for phases and COUNTERS for counters, -t needs TRACING, -p needs TIMING
+// -u re-solves warm with pr, ppr or lfppr, and needs a generated or DIMACS graph
 Graph::Graph(int argc, char **argv) {
-    assert(argc == 3);
-    V = atoi(argv[1]);
-    D = (double)atoi(argv[2]) / 100.0;
+    input = NULL;
+    output = NULL;
+    method = NULL;
+    tree = NULL;
+    cutOnly = false;
+    updates = 0;
+    repeats = 1;
+    stats = NULL;
+    trace = NULL;
+    perf = false;
+    certificate = NULL;
+    qtype = QTYPE;
+#ifdef SPINLOCK
+    spinLock = true;
+#else
+    spinLock = false;
+#endif
+#ifdef GRAPH_ONE_WAY
+    oneWay = true;
+#else
+    oneWay = false;
+#endif
+#ifdef GRAPH_ACYCLIC
+    acyclic = true;
+#else
+    acyclic = false;
+#endif
+    for (int opt; (opt = getopt(argc, argv, "a:cf:g:k:l:m:o:pq:r:s:t:u:")) != -1;) {
+        switch (opt) {
+            case 'a':
+                tree = optarg;
+                break;
+            case 'c':
+                cutOnly = true;
+                break;
+            case 'f':
+                input = optarg;
+                break;
+            case 'g':
+                oneWay = strstr(optarg, "oneway") != NULL;
+                acyclic = strstr(optarg, "acyclic") != NULL;
+                break;
+            case 'k':
+                certificate = optarg;
+                break;
+            case 'l':
+                if (strcmp(optarg, "spin") != 0 && strcmp(optarg, "mutex") != 0) {
+                    fprintf(stderr, "Unknown lock %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                spinLock = strcmp(optarg, "spin") == 0;
+                break;
+            case 'm':
+                method = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'p':
+#ifndef TIMING
+                fprintf(stderr, "-p needs a build with TIMING\n");
+                exit(EXIT_FAILURE);
+#endif
+                perf = true;
+                break;
+            case 'q':
+                qtype = atoi(optarg);
+                if (qtype < 0 || qtype >= NUM_QTYPE) {
+                    fprintf(stderr, "Unknown queue type %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'r':
+                repeats = atoi(optarg);
+                break;
+            case 's':
+                stats = optarg;
+                break;
+            case 't':
+#ifndef TRACING
+                fprintf(stderr, "-t needs a build with TRACING\n");
+                exit(EXIT_FAILURE);
+#endif
+                trace = optarg;
+                break;
+            case 'u':
+                updates = atoi(optarg);
+                break;
+            default:
+                assert(false);
+        }
+    }
+    // Before anything is solved, perturb could only refuse after the first solve
+    if (updates > 0 && input && isSnapshot(input)) {
+        fprintf(stderr, "%s: snapshots are mapped read-only, -u cannot change capacities\n", input);
+        exit(EXIT_FAILURE);
+    }
+    if (input) {
+        assert(optind == argc);
+        V = 0;
+        D = 0;
+    } else {
+        assert(argc - optind == 2);
+        V = atoi(argv[optind]);
+        D = atof(argv[optind + 1]) / 100.0;  // Percent, may be fractional
+    }
     ncpus = omp_get_max_threads();
+    memset(&csr, 0, sizeof(csr));
 }
 
-inline int randInt(int min, int max) {
-    return rand() % (max - min + 1) + min;
+Graph::~Graph() {
+    freeResidualGraph(&csr);
 }
 
-inline double randDouble(double min, double max) {
-    return rand() * (max - min) / (RAND_MAX + 1.0) + min;
+// Counter-based RNG, the value only depends on (seed, r, c, stream)
+inline unsigned long long hash64(unsigned long long seed, long long r, long long c, int stream) {
+    unsigned long long x = seed;
+    unsigned long long keys[3] = {(unsigned long long)r, (unsigned long long)c, (unsigned long long)stream};
+    for (int i = 0; i < 3; i++) {
+        x += keys[i] + 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        x = x ^ (x >> 31);
+    }
+    return x;
 }
 
-void dfs(int u, int &time, std::vector<int> &d, std::vector<int> &f, std::vector<int> &c, std::vector<std::vector<std::pair<int, int>>> &raw, std::vector<std::vector<std::pair<int, int>>> &edge) {
-    c[u] = 1;
-    time = time + 1;
-    d[u] = time;
-    for (auto e : raw[u]) {
-        if (c[e.first] != 2) {
-            edge[u].emplace_back(e);
-        }
-        if (c[e.first] == 0) {
-            dfs(e.first, time, d, f, c, raw, edge);
+// Uniform in (0, 1]
+inline double hashDouble(unsigned long long h) {
+    return ((h >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+// Number of candidates skipped before the next hit, Geometric(D)
+inline long long geometricSkip(double logq, unsigned long long h) {
+    if (logq == 0)
+        return 0;
+    double skip = log(hashDouble(h)) / logq;
+    return skip < 4e18 ? (long long)skip : 0x3fffffffffffffffLL;
+}
+
+#define GENERATE_BLOCK 64
+
+// Edges sampled from rows [r0, r1), in (r, c) order
+inline void generateRows(unsigned long long seed, int V, double D, bool oneWay, int r0, int r1, std::vector<int> &tail, std::vector<int> &head, std::vector<int> &cap) {
+    if (D <= 0)
+        return;
+    double logq = D < 1 ? log1p(-D) : 0;
+    for (int r = r0; r < r1; r++) {
+        long long n = oneWay ? r : V;  // One-way samples each pair once, from its higher row
+        for (long long c = -1;;) {
+            c += 1 + geometricSkip(logq, hash64(seed, r, c + 1, 0));
+            if (c >= n)
+                break;
+            unsigned long long h = hash64(seed, r, c, 1);
+            int w = (h & 0xffffffffULL) % 10001;
+            if (w > 0) {
+                if (h >> 63) {
+                    tail.push_back(r);
+                    head.push_back(c);
+                } else {
+                    tail.push_back(c);
+                    head.push_back(r);
+                }
+                cap.push_back(w);
+            }
         }
     }
-    c[u] = 2;
-    time = time + 1;
-    f[u] = time;
 }
 
-void Graph::generate() {
-    srand(17 ^ V);
+// Level-synchronous BFS from S over the sampled edges, level[v] = -1 if unreachable.
+// Levels do not depend on which thread discovers a vertex first.
+inline void bfsLevel(int V, int S, int M, const int *tail, const int *head, int *level) {
+    int *offset = (int *)malloc(sizeof(int) * (V + 1));
+    int *pos = (int *)malloc(sizeof(int) * V);
+    int *adj = (int *)malloc(sizeof(int) * M);
+    int *frontier = (int *)malloc(sizeof(int) * V);
+    int *next = (int *)malloc(sizeof(int) * V);
 
-    S = randInt(0, V - 1);
-    do {
-        T = randInt(0, V - 1);
-    } while (T == S);
+#pragma omp parallel for
+    for (int u = 0; u <= V; u++) {
+        offset[u] = 0;
+        if (u < V)
+            level[u] = -1;
+    }
+#pragma omp parallel for
+    for (int i = 0; i < M; i++) {
+#pragma omp atomic
+        offset[tail[i] + 1]++;
+    }
+    for (int u = 0; u < V; u++) {
+        offset[u + 1] += offset[u];
+    }
+    memcpy(pos, offset, sizeof(int) * V);
+#pragma omp parallel for
+    for (int i = 0; i < M; i++) {
+        int a;
+#pragma omp atomic capture
+        a = pos[tail[i]]++;
+        adj[a] = head[i];
+    }
 
-    std::vector<std::vector<std::pair<int, int>>> raw(V);
-    // one-way edge
-#ifdef GRAPH_ONE_WAY
-    for (int r = 0; r < V; r++) {
-        for (int c = 0; c < r; c++) {
-            double prob = randDouble(0, 1);
-            if (prob < D) {
-                int cap = randInt(0, 10000);
-                if (cap > 0) {
-                    if (prob < D / 2) {
-                        raw[r].emplace_back(c, cap);
-                    } else {
-                        raw[c].emplace_back(r, cap);
-                    }
+    int nfrontier = 1;
+    frontier[0] = S;
+    level[S] = 0;
+    for (int L = 0; nfrontier > 0; L++) {
+        int nnext = 0;
+#pragma omp parallel for schedule(dynamic, 64)
+        for (int k = 0; k < nfrontier; k++) {
+            int u = frontier[k];
+            for (int a = offset[u]; a < offset[u + 1]; a++) {
+                int v = adj[a];
+                if (level[v] == -1 && __sync_bool_compare_and_swap(&level[v], -1, L + 1)) {
+                    int idx;
+#pragma omp atomic capture
+                    idx = nnext++;
+                    next[idx] = v;
                 }
             }
         }
+        int *tmp = frontier;
+        frontier = next;
+        next = tmp;
+        nfrontier = nnext;
     }
-#else
-    for (int r = 0; r < V; r++) {
-        for (int c = 0; c < V; c++) {
-            double prob = randDouble(0, 1);
-            if (prob < D) {
-                int cap = randInt(0, 10000);
-                if (cap > 0) {
-                    if (prob < D / 2) {
-                        raw[r].emplace_back(c, cap);
-                    } else {
-                        raw[c].emplace_back(r, cap);
-                    }
-                }
+
+    free(offset);
+    free(pos);
+    free(adj);
+    free(frontier);
+    free(next);
+}
+
+// Keeps the edges reachable from S that go forward in (BFS level, vertex id)
+// order. The order is total, so the result is a DAG, and every reachable
+// vertex keeps the edge from its BFS parent, so it stays rooted at S.
+inline int orientAcyclic(int V, int S, int M, int **tail, int **head, int **cap) {
+    int *level = (int *)malloc(sizeof(int) * V);
+    bfsLevel(V, S, M, *tail, *head, level);
+
+    int nchunk = omp_get_max_threads() * 4;
+    std::vector<int> first(nchunk + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < nchunk; k++) {
+        int cnt = 0;
+        for (int i = (long long)M * k / nchunk; i < (long long)M * (k + 1) / nchunk; i++) {
+            int u = (*tail)[i], v = (*head)[i];
+            cnt += level[u] != -1 && (level[u] < level[v] || (level[u] == level[v] && u < v));
+        }
+        first[k + 1] = cnt;
+    }
+    for (int k = 0; k < nchunk; k++) {
+        first[k + 1] += first[k];
+    }
+
+    int N = first[nchunk];
+    int *ntail = (int *)malloc(sizeof(int) * N);
+    int *nhead = (int *)malloc(sizeof(int) * N);
+    int *ncap = (int *)malloc(sizeof(int) * N);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < nchunk; k++) {
+        int j = first[k];
+        for (int i = (long long)M * k / nchunk; i < (long long)M * (k + 1) / nchunk; i++) {
+            int u = (*tail)[i], v = (*head)[i];
+            if (level[u] != -1 && (level[u] < level[v] || (level[u] == level[v] && u < v))) {
+                ntail[j] = u;
+                nhead[j] = v;
+                ncap[j] = (*cap)[i];
+                j++;
             }
         }
     }
-#endif
 
-#ifdef GRAPH_ACYCLIC
-    edge.resize(V);
-    // Acyclic edge
-    int time = 0;
-    std::vector<int> d(V, 0);
-    std::vector<int> f(V, 0);
-    std::vector<int> c(V, 0);
-    dfs(S, time, d, f, c, raw, edge);
-#else
-    edge = raw;
-#endif
+    free(level);
+    free(*tail);
+    free(*head);
+    free(*cap);
+    *tail = ntail;
+    *head = nhead;
+    *cap = ncap;
+    return N;
+}
 
-    // count & capacity
-    E = 0;
-    for (int u = 0; u < V; u++) {
-        E += edge[u].size();
+// Row blocks are sampled in parallel and concatenated in block order,
+// so the graph is the same for any number of threads
+void Graph::generate() {
+    unsigned long long seed = 17 ^ V;
+
+    S = hash64(seed, -1, 0, 2) % V;
+    for (int k = 1; (T = hash64(seed, -1, k, 2) % V) == S; k++)
+        ;
+
+    int nblock = (V + GENERATE_BLOCK - 1) / GENERATE_BLOCK;
+    std::vector<std::vector<int>> btail(nblock), bhead(nblock), bcap(nblock);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int b = 0; b < nblock; b++) {
+        int r0 = b * GENERATE_BLOCK;
+        int r1 = r0 + GENERATE_BLOCK < V ? r0 + GENERATE_BLOCK : V;
+        generateRows(seed, V, D, oneWay, r0, r1, btail[b], bhead[b], bcap[b]);
     }
+
+    std::vector<long long> first(nblock + 1, 0);
+    for (int b = 0; b < nblock; b++) {
+        first[b + 1] = first[b] + btail[b].size();
+    }
+    if (first[nblock] > MAX_EDGES) {
+        fprintf(stderr, "%lld edges sampled, at most %d are supported\n", first[nblock], MAX_EDGES);
+        exit(EXIT_FAILURE);
+    }
+    int M = first[nblock];
+    int *tail = (int *)malloc(sizeof(int) * M);
+    int *head = (int *)malloc(sizeof(int) * M);
+    int *cap = (int *)malloc(sizeof(int) * M);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int b = 0; b < nblock; b++) {
+        memcpy(tail + first[b], btail[b].data(), sizeof(int) * btail[b].size());
+        memcpy(head + first[b], bhead[b].data(), sizeof(int) * bhead[b].size());
+        memcpy(cap + first[b], bcap[b].data(), sizeof(int) * bcap[b].size());
+        std::vector<int>().swap(btail[b]);
+        std::vector<int>().swap(bhead[b]);
+        std::vector<int>().swap(bcap[b]);
+    }
+
+    if (acyclic)
+        M = orientAcyclic(V, S, M, &tail, &head, &cap);
+    buildResidualGraph(&csr, V, M, tail, head, cap);
+    E = csr.E;
+
+    free(tail);
+    free(head);
+    free(cap);
+}
+
+// Picks UPDATE_BATCH edges and draws new capacities for them with the generator's
+// hash, so every round is reproducible. The capacities in csr are updated in place.
+int Graph::perturb(int round, int *edge, int *cap) {
+    if (csr.map) {
+        fprintf(stderr, "%s: snapshots are mapped read-only, capacities cannot change\n", input);
+        exit(EXIT_FAILURE);
+    }
+    unsigned long long seed = 17 ^ V;
+    int n = E < UPDATE_BATCH ? E : UPDATE_BATCH;
+    for (int k = 0; k < n; k++) {
+        unsigned long long h = hash64(seed, round, k, 3);
+        edge[k] = (h >> 32) % E;
+        cap[k] = (h & 0xffffffffULL) % 10001;
+        csr.cap[csr.arc[edge[k]]] = cap[k];
+    }
+    return n;
+}
+
+void Graph::load() {
+    if (isSnapshot(input))
+        mapSnapshot(input, &V, &S, &T, &csr);
+    else
+        loadDimacs(input, &V, &S, &T, &csr);
+    E = csr.E;
+}
+
+void Graph::save() {
+    saveSnapshot(output, S, T, &csr);
 }
 
 enum {
@@ -111,70 +391,114 @@ enum {
     NEGATIVE_FLOW,
     CAPACITY_EXCEED,
     NETFLOW_NONZERO,
-    REACHED_TARGET
+    REACHED_TARGET,
+    CUT_MISMATCH
 };
 
-inline int check(int V, int S, int T, int *capacity, bool *visit, int *sum, int *flow) {
-    memset(sum, 0, sizeof(int) * V);
-    for (int r = 0; r < V; r++) {
-        for (int c = 0; c < V; c++) {
-            if (r == c) {
-                if (!(flow[r * V + c] == 0))
-                    return SELF_CYCLE;
-            } else {
-                if (!(flow[r * V + c] >= 0))
-                    return NEGATIVE_FLOW;
-                if (!(flow[r * V + c] <= capacity[r * V + c]))
-                    return CAPACITY_EXCEED;
-                capacity[r * V + c] -= flow[r * V + c];
-                capacity[c * V + r] += flow[r * V + c];
-            }
-            sum[r] -= flow[r * V + c];
-            sum[c] += flow[r * V + c];
+// Capacities per edge, conservation per vertex from the net flow over its own
+// arcs, then a level-synchronous BFS from S on the residual graph. The vertices
+// it reaches are the source side of a cut, which is a min cut if its capacity
+// equals the flow value. O(V + E) work, every step a parallel loop.
+inline int check(const ResidualGraph *csr, int S, int T, const int *flow, int *residual, char *cut, int *frontier, int *next, long long *value, long long *capacity) {
+    int V = csr->V;
+    int E = csr->E;
+    int selfCycle = 0;
+    int negative = 0;
+    int exceed = 0;
+#pragma omp parallel for reduction(+ : selfCycle, negative, exceed)
+    for (int i = 0; i < E; i++) {
+        int a = csr->arc[i];
+        if (csr->head[csr->rev[a]] == csr->head[a]) {
+            selfCycle += flow[i] != 0;
+        } else {
+            negative += flow[i] < 0;
+            exceed += flow[i] > csr->cap[a];
         }
+        residual[a] = csr->cap[a] - flow[i];
+        residual[csr->rev[a]] = flow[i];
     }
+    if (selfCycle)
+        return SELF_CYCLE;
+    if (negative)
+        return NEGATIVE_FLOW;
+    if (exceed)
+        return CAPACITY_EXCEED;
 
-    for (int i = 0; i < V; i++) {
-        if (i != S && i != T && sum[i] != 0) {
-            return NETFLOW_NONZERO;
+    // Arc a carries cap[a] - residual[a], negative on reverse arcs
+    int unbalanced = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : unbalanced)
+    for (int u = 0; u < V; u++) {
+        long long out = 0;
+        for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+            out += csr->cap[a] - residual[a];
         }
+        if (u == T)
+            *value = -out;
+        else if (u != S)
+            unbalanced += out != 0;
     }
+    if (unbalanced)
+        return NETFLOW_NONZERO;
 
-    memset(visit, 0, sizeof(bool) * V);
-    std::queue<int> q;
-    q.emplace(S);
-    visit[S] = true;
-
-    while (!q.empty()) {
-        int u = q.front();
-        q.pop();
-        for (int v = 0; v < V; v++) {
-            if (!visit[v] && capacity[u * V + v] > 0) {
-                visit[v] = true;
-                q.emplace(v);
-                if (v == T)
-                    return REACHED_TARGET;
+    memset(cut, 0, sizeof(char) * V);
+    cut[S] = 1;
+    frontier[0] = S;
+    for (int nfrontier = 1; nfrontier > 0;) {
+        int nnext = 0;
+#pragma omp parallel for schedule(dynamic, 64)
+        for (int k = 0; k < nfrontier; k++) {
+            int u = frontier[k];
+            for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+                int v = csr->head[a];
+                if (!cut[v] && residual[a] > 0 && __sync_bool_compare_and_swap(&cut[v], 0, 1)) {
+                    int idx;
+#pragma omp atomic capture
+                    idx = nnext++;
+                    next[idx] = v;
+                }
             }
         }
+        int *tmp = frontier;
+        frontier = next;
+        next = tmp;
+        nfrontier = nnext;
     }
+    if (cut[T])
+        return REACHED_TARGET;
 
-    return SUCCESS;
+    long long sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+    for (int i = 0; i < E; i++) {
+        int a = csr->arc[i];
+        if (cut[csr->head[csr->rev[a]]] && !cut[csr->head[a]])
+            sum += csr->cap[a];
+    }
+    *capacity = sum;
+    return sum == *value ? SUCCESS : CUT_MISMATCH;
 }
 
 void Graph::verify(int *flow) {
-    bool *visit = (bool *)malloc(sizeof(bool) * V);
-    int *sum = (int *)malloc(sizeof(int) * V);
-    int *capacity = (int *)malloc(V * V * sizeof(int));
+    char *cut = (char *)malloc(sizeof(char) * V);
+    int *frontier = (int *)malloc(sizeof(int) * V);
+    int *next = (int *)malloc(sizeof(int) * V);
+    int *residual = (int *)malloc(sizeof(int) * 2 * csr.E);
+    long long value = 0;
+    long long capacity = 0;
     int err;
 
-    memset(capacity, 0, sizeof(int) * V * V);
-    for (int u = 0; u < V; u++) {
-        for (auto e : edge[u]) {
-            capacity[u * V + e.first] = e.second;
+    err = check(&csr, S, T, flow, residual, cut, frontier, next, &value, &capacity);
+    if (err == SUCCESS || err == CUT_MISMATCH) {
+        int side = 0;
+#pragma omp parallel for reduction(+ : side)
+        for (int u = 0; u < V; u++) {
+            side += cut[u];
         }
+        printf(" Min Cut: %lld\n", capacity);
+        printf(" Source side: %d vertices\n", side);
     }
-    err = check(V, S, T, capacity, visit, sum, flow);
     if (err == SUCCESS) {
+        if (certificate)
+            saveCut(certificate, cut);
         printf("\033[1;32m");
         printf("Passed.\n");
         printf("\033[0m");
@@ -197,12 +521,65 @@ void Graph::verify(int *flow) {
             case REACHED_TARGET:
                 printf("REACHED_TARGET\n");
                 break;
+            case CUT_MISMATCH:
+                printf("CUT_MISMATCH, flow value %lld\n", value);
+                break;
         }
         printf("\033[0m");
     }
 
     // Finalize
-    free(capacity);
-    free(visit);
-    free(sum);
+    free(residual);
+    free(cut);
+    free(frontier);
+    free(next);
+}
+
+// Source side vertices, one per line
+void Graph::saveCut(const char *path, const char *cut) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    for (int u = 0; u < V; u++) {
+        if (cut[u])
+            fprintf(fp, "%d\n", u);
+    }
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "%s: write failed\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void Graph::verifyCut(const char *cut, long long value) {
+    long long capacity = 0;
+    int side = 0;
+#pragma omp parallel for reduction(+ : capacity)
+    for (int i = 0; i < csr.E; i++) {
+        int a = csr.arc[i];
+        if (cut[csr.head[csr.rev[a]]] && !cut[csr.head[a]])
+            capacity += csr.cap[a];
+    }
+#pragma omp parallel for reduction(+ : side)
+    for (int u = 0; u < V; u++) {
+        side += cut[u];
+    }
+    printf(" Min Cut: %lld\n", capacity);
+    printf(" Source side: %d vertices\n", side);
+    if (cut[S] && !cut[T] && capacity == value) {
+        if (certificate)
+            saveCut(certificate, cut);
+        printf("\033[1;32m");
+        printf("Passed.\n");
+        printf("\033[0m");
+    } else {
+        printf("\033[1;31m");
+        printf("Failed.\n");
+        if (!cut[S] || cut[T])
+            printf("NOT_SEPARATING\n");
+        else
+            printf("CUT_MISMATCH, flow value %lld\n", value);
+        printf("\033[0m");
+    }
 }
@@ -1,7 +1,8 @@
 #ifndef GRAPH
 #define GRAPH
-#include <utility>
-#include <vector>
+#include "residual-graph.hh"
+
+#define UPDATE_BATCH 256  // Edges whose capacity changes in one warm-start round (-u)
 
 class Graph {
    public:
@@ -11,12 +12,37 @@ class Graph {
     int T;
     double D;
     int ncpus;
-    std::vector<std::vector<std::pair<int, int>>> edge;
+    const char *input;   // DIMACS file or snapshot, NULL to generate
+    const char *output;  // Snapshot to write instead of solving, or NULL
+    const char *method;  // Max-flow method name, NULL for the METHOD default
+    int qtype;           // Active vertex queue of the push-relabel engines, see QTYPE in the Makefile
+    bool spinLock;       // Spin locks instead of mutexes in the parallel engine
+    bool oneWay;         // At most one generated edge per vertex pair
+    bool acyclic;        // Generated edges are oriented along BFS levels from S
+    const char *tree;    // Gomory-Hu tree to write instead of solving, or NULL
+    bool cutOnly;        // Stop once the min cut is known, no flow on the edges
+    int updates;         // Warm-start rounds of random capacity changes after the first solve
+    int repeats;         // Cold solves of the graph in a row on one Solver
+    const char *stats;   // JSON report of phase timings and counters to write after solving, or NULL
+    const char *trace;   // Chrome trace of the parallel engine to write after solving, or NULL
+    bool perf;           // Hardware counters for every TIMING scope
+    const char *certificate;  // Source side of the verified min cut to write, or NULL
+    ResidualGraph csr;
 
     Graph(int argc, char **argv);
-    ~Graph() {}
+    ~Graph();
     void generate();
+    void load();
+    void save();
+    int perturb(int round, int *edge, int *cap);  // Changes up to UPDATE_BATCH capacities
+    // flow[i] is the flow on the i-th edge of csr.arc. Checks it is a feasible
+    // flow and that its value equals the capacity of the cut it leaves in the
+    // residual graph, which certifies both as maximum.
     void verify(int *flow);
+    // cut[u] is 1 on the source side. Checks it separates S from T and that its
+    // capacity equals the max flow value the solver reported.
+    void verifyCut(const char *cut, long long value);
+    void saveCut(const char *path, const char *cut);
 };
 
 #endif  // GRAPH
\ No newline at end of file
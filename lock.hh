@@ -0,0 +1,49 @@
+#ifndef LOCK
+#define LOCK
+
+#include <pthread.h>
+
+// Vertex and queue lock policies of the parallel engine, same members for both
+namespace LOCK {
+struct SpinLock {
+    pthread_spinlock_t lock;
+
+    void init() {
+        pthread_spin_init(&lock, 0);
+    }
+    void destroy() {
+        pthread_spin_destroy(&lock);
+    }
+    void acquire() {
+        pthread_spin_lock(&lock);
+    }
+    bool tryAcquire() {
+        return pthread_spin_trylock(&lock) == 0;
+    }
+    void release() {
+        pthread_spin_unlock(&lock);
+    }
+};
+
+struct MutexLock {
+    pthread_mutex_t lock;
+
+    void init() {
+        pthread_mutex_init(&lock, 0);
+    }
+    void destroy() {
+        pthread_mutex_destroy(&lock);
+    }
+    void acquire() {
+        pthread_mutex_lock(&lock);
+    }
+    bool tryAcquire() {
+        return pthread_mutex_trylock(&lock) == 0;
+    }
+    void release() {
+        pthread_mutex_unlock(&lock);
+    }
+};
+}  // namespace LOCK
+
+#endif  // LOCK
@@ -2,63 +2,147 @@
 #include <cstdlib>
 #include <cstring>
 
-#include "ford-fulkerson.hh"
+#include "gomory-hu.hh"
 #include "graph.hh"
 #include "parallel-push-relabel.hh"
+#include "profile.hh"
 #include "push-relabel.hh"
+#include "solver.hh"
+#include "stats.hh"
+#include "trace.hh"
 #include "utility.hh"
 
-enum Method {
-    ff,
-    pr,
-    ppr,
-};
-const Method method = METHOD;
+// Solves once, then re-solves warm after each of graph->updates rounds of capacity
+// changes, with the pr session or the ppr and lfppr one. Every solve but the last
+// is verified here, the last one by main. Returns the max flow value of the last solve.
+static int warmStart(Graph *graph, Method method, int *flow, char *cut) {
+    int *edge = (int *)malloc(sizeof(int) * UPDATE_BATCH);
+    int *cap = (int *)malloc(sizeof(int) * UPDATE_BATCH);
+    PushRelabelSession *prSession = NULL;
+    ParallelPushRelabelSession *pprSession = NULL;
+    int value;
+    if (method == pr) {
+        prSession = openPushRelabel(graph);
+        TIMING_START(PushRelabel);
+        value = solvePushRelabel(prSession, flow, cut);
+        TIMING_END(PushRelabel);
+    } else {
+        pprSession = openParallelPushRelabel(graph, method == lfppr);
+        TIMING_START(ParallelPushRelabel);
+        value = solveParallelPushRelabel(pprSession, flow, cut);
+        TIMING_END(ParallelPushRelabel);
+    }
+    for (int round = 0; round < graph->updates; round++) {
+        if (cut)
+            graph->verifyCut(cut, value);
+        else
+            graph->verify(flow);
+        int n = graph->perturb(round, edge, cap);
+        TIMING_START(WarmStart);
+        if (prSession) {
+            updatePushRelabel(prSession, n, edge, cap);
+            value = solvePushRelabel(prSession, flow, cut);
+        } else {
+            updateParallelPushRelabel(pprSession, n, edge, cap);
+            value = solveParallelPushRelabel(pprSession, flow, cut);
+        }
+        TIMING_END(WarmStart);
+    }
+    if (prSession)
+        closePushRelabel(prSession);
+    else
+        closeParallelPushRelabel(pprSession);
+    free(edge);
+    free(cap);
+    return value;
+}
 
 int main(int argc, char **argv) {
     Graph *graph = new Graph(argc, argv);  // Graph
-    int *flow;                             // Output flow matrix
+    if (graph->perf)
+        profilePerf();
+    int *flow = NULL;                      // Output flow of each edge, NULL with -c
+    char *cut = NULL;                      // Source side of the min cut with -c
+    int value = 0;                         // Max flow value the solver reported
+    Method method = graph->method ? parseMethod(graph->method) : METHOD;
+    if (graph->cutOnly && method != pr && method != ppr && method != lfppr) {
+        fprintf(stderr, "Method %s has no min-cut-only mode\n", methodName[method]);
+        exit(EXIT_FAILURE);
+    }
+    if (graph->updates > 0 && method != pr && method != ppr && method != lfppr) {
+        fprintf(stderr, "Method %s has no warm-start session\n", methodName[method]);
+        exit(EXIT_FAILURE);
+    }
 
     // Generate
     TIMING_START(Generate);
-    graph->generate();
+    if (graph->input)
+        graph->load();
+    else
+        graph->generate();
     TIMING_END(Generate);
 
-    flow = (int *)malloc(graph->V * graph->V * sizeof(int));
-    memset(flow, 0, graph->V * graph->V * sizeof(int));
+    if (graph->output) {
+        TIMING_START(Snapshot);
+        graph->save();
+        TIMING_END(Snapshot);
+        delete graph;
+        return 0;
+    }
+
+    if (graph->tree) {
+        GomoryHuTree tree;
+        TIMING_START(GomoryHu);
+        GomoryHu(graph, &tree);
+        TIMING_END(GomoryHu);
+        saveGomoryHu(graph->tree, &tree);
+        printf(" Min Cut S-T: %d\n", queryGomoryHu(&tree, graph->S, graph->T));
+        freeGomoryHu(&tree);
+        delete graph;
+        return 0;
+    }
+
+    if (graph->cutOnly) {
+        cut = (char *)malloc(graph->V * sizeof(char));
+    } else {
+        flow = (int *)malloc(graph->E * sizeof(int));
+        memset(flow, 0, graph->E * sizeof(int));
+    }
 
     printf("V: %d\n", graph->V);
     printf("E: %d\n", graph->E);
 
     // Max-Flow
-    switch (method) {
-        case ff:
-            TIMING_START(FordFulkerson);
-            FordFulkerson(graph, flow);
-            TIMING_END(FordFulkerson);
-            break;
-        case pr:
-            TIMING_START(PushRelabel);
-            PushRelabel(graph, flow);
-            TIMING_END(PushRelabel);
-            break;
-        case ppr:
-            TIMING_START(ParallelPushRelabel);
-            ParallelPushRelabel(graph, flow);
-            TIMING_END(ParallelPushRelabel);
-            break;
-
-        default:
-            break;
+    if (graph->updates > 0) {
+        value = warmStart(graph, method, flow, cut);
+    } else {
+        TIMING_START(Setup);
+        Solver *solver = new Solver(method, graph->V, graph->E, graph->ncpus, graph->qtype, graph->spinLock);
+        TIMING_END(Setup);
+        // Repeats reuse the buffers and threads of the first solve, main verifies the last one
+        for (int r = 0; r < graph->repeats; r++) {
+            value = solver->solve(graph, flow, cut);
+        }
+        delete solver;
     }
     // Max-Flow End
 
     // Verify
     TIMING_START(Verify);
-    graph->verify(flow);
+    if (cut)
+        graph->verifyCut(cut, value);
+    else
+        graph->verify(flow);
     TIMING_END(Verify);
 
+    if (graph->stats)
+        statsSave(graph->stats, methodName[method], graph->V, graph->E, graph->ncpus);
+    if (graph->trace)
+        traceSave(graph->trace, graph->ncpus);
+    profileReport();
+
     // Finalize
     delete graph;
     free(flow);
+    free(cut);
 }
\ No newline at end of file
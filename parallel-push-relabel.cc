@@ -2,6 +2,7 @@
 
 #include <omp.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include <cstdio>
 #include <cstdlib>
@@ -10,38 +11,68 @@
 #include <vector>
 
 #include "graph.hh"
+#include "lock.hh"
+#include "queue.hh"
+#include "stats.hh"
+#include "trace.hh"
 #include "utility.hh"
 
 namespace PPR {
+// Compile-time choice of queue, lock and discharge, one specialization per combination
+template <class Q, class L, bool LF>
+struct Policy {
+    typedef Q Queue;
+    typedef L Lock;
+    static const bool lockFree = LF;  // Hong's lock-free discharge, no vertex locks
+};
+
+template <class P>
+struct Worker;
+
+template <class P>
 struct Data {
     int V;
     int S;
     int T;
     int ncpus;
-    int *edge;
-    int *nedge;
+    const ResidualGraph *csr;
+    int *cap;  // Arc capacities, csr->cap or a private copy in a warm-start session
     int *excess;
     int *residual;
     int *height;
+    int *current;  // Current arc of the lock-based discharge, arcs before it are not admissible
     int *inqueue;
     int *vertexCnt;
-#if QTYPE == 0
-    int *queue;
-    int queSize;
-    int queFront;
-    int queBack;
-#elif QTYPE == 1 || QTYPE == 2 || QTYPE == 3 || QTYPE == 4
-    int *queue;
-    int queSize;
-    int *label;
-#endif
-#ifdef SPINLOCK
-    pthread_spinlock_t *vertexLock;
-    pthread_spinlock_t queLock;
-#else
-    pthread_mutex_t *vertexLock;
-    pthread_mutex_t queLock;
-#endif
+    int *heightCnt;       // Number of vertices at each height below V, S excluded
+    int gapPending;       // Some height below V emptied, lift at the next stop
+    int *frontier;        // Global relabel BFS frontiers
+    int *nextFrontier;
+    long long work;       // Relabel work since the last global relabel
+    long long workLimit;  // Global relabel threshold
+    int busy;             // Workers that are not idle, 0 means no excess is left to move
+    int phase1;           // Vertices at height V or above wait for phase 2
+    int *deferred;        // Active vertices set aside in phase 1, still marked inqueue
+    int nDeferred;
+    typename P::Queue que;         // Active vertices, one of the QUE policies
+    typename P::Lock *vertexLock;  // NULL with the lock-free discharge
+    typename P::Lock queLock;      // Guards que unless it is concurrent
+    Counters *counters;  // One slot per worker, the main thread last
+    int maxV;            // Vertices and edges the arena is carved for
+    int maxE;
+    bool ownCap;         // cap is a copy in the arena
+    Arena arena;
+    // Worker pool, kept from create to destroy
+    Worker<P> *workers;
+    pthread_t *threads;
+    pthread_barrier_t roundStart;
+    pthread_barrier_t roundEnd;
+    bool quit;
+};
+
+template <class P>
+struct Worker {
+    Data<P> *data;
+    int tid;
 };
 
 inline int min(int x, int y) {
@@ -51,338 +82,559 @@ inline int min(int x, int y) {
         return y;
 }
 
-inline void swap(int *x, int *y) {
-    int tmp = *x;
-    *x = *y;
-    *y = tmp;
-}
-
-inline void quePush(Data *data, int u) {
-#ifdef SPINLOCK
-    pthread_spin_lock(&data->queLock);
-#else
-    pthread_mutex_lock(&data->queLock);
-#endif
-#if QTYPE == 0
-    data->queue[data->queBack] = u;
-    data->queBack = (data->queBack + 1) % data->V;
-    data->queSize++;
-#elif QTYPE == 1 || QTYPE == 2 || QTYPE == 3
-    data->queue[++data->queSize] = u;
-    int idx = data->queSize;
-    while (idx > 1 && data->label[data->queue[idx]] > data->label[data->queue[idx / 2]]) {
-        swap(&data->queue[idx], &data->queue[idx / 2]);
-        idx = idx / 2;
-    }
-#elif QTYPE == 4
-    data->queue[++data->queSize] = u;
-    int idx = data->queSize;
-    while (idx > 1 && data->label[data->queue[idx]] < data->label[data->queue[idx / 2]]) {
-        swap(&data->queue[idx], &data->queue[idx / 2]);
-        idx = idx / 2;
-    }
-#endif
-#ifdef SPINLOCK
-    pthread_spin_unlock(&data->queLock);
-#else
-    pthread_mutex_unlock(&data->queLock);
-#endif
-}
-
-inline int quePop(Data *data) {
-    int retVal = -1;
-#ifdef SPINLOCK
-    pthread_spin_lock(&data->queLock);
-#else
-    pthread_mutex_lock(&data->queLock);
-#endif
-#if QTYPE == 0
-    if (data->queSize > 0) {
-        retVal = data->queue[data->queFront];
-        data->queFront = (data->queFront + 1) % data->V;
-        data->queSize--;
-    }
-#elif QTYPE == 1 || QTYPE == 2 || QTYPE == 3
-    if (data->queSize > 0) {
-        retVal = data->queue[1];
-        data->queue[1] = data->queue[data->queSize--];
-        int idx = 1;
-        while (idx * 2 + 1 <= data->queSize && (data->label[data->queue[idx]] < data->label[data->queue[idx * 2]] || data->label[data->queue[idx]] < data->label[data->queue[idx * 2 + 1]])) {
-            if (data->label[data->queue[idx * 2]] > data->label[data->queue[idx * 2 + 1]]) {
-                swap(&data->queue[idx], &data->queue[idx * 2]);
-                idx = idx * 2;
-            } else {
-                swap(&data->queue[idx], &data->queue[idx * 2 + 1]);
-                idx = idx * 2 + 1;
-            }
-        }
-        if (idx * 2 <= data->queSize && data->label[data->queue[idx]] < data->label[data->queue[idx * 2]]) {
-            swap(&data->queue[idx], &data->queue[idx * 2]);
-        }
+// Queues that are not concurrent take queLock
+template <class P>
+inline void quePush(Data<P> *data, int u) {
+    if (P::Queue::concurrent) {
+        data->que.push(u);
+        return;
     }
-#elif QTYPE == 4
-    if (data->queSize > 0) {
-        retVal = data->queue[1];
-        data->queue[1] = data->queue[data->queSize--];
-        int idx = 1;
-        while (idx * 2 + 1 <= data->queSize && (data->label[data->queue[idx]] > data->label[data->queue[idx * 2]] || data->label[data->queue[idx]] > data->label[data->queue[idx * 2 + 1]])) {
-            if (data->label[data->queue[idx * 2]] < data->label[data->queue[idx * 2 + 1]]) {
-                swap(&data->queue[idx], &data->queue[idx * 2]);
-                idx = idx * 2;
-            } else {
-                swap(&data->queue[idx], &data->queue[idx * 2 + 1]);
-                idx = idx * 2 + 1;
+    STATS_ACQUIRE(data->queLock);
+    data->que.push(u);
+    data->queLock.release();
+}
+
+template <class P>
+inline int quePop(Data<P> *data) {
+    int u;
+    if (P::Queue::concurrent) {
+        u = data->que.pop();
+    } else {
+        STATS_ACQUIRE(data->queLock);
+        u = data->que.pop();
+        data->queLock.release();
+    }
+    STATS_ADD(pops, u != -1);
+    STATS_ADD(emptyPolls, u == -1);
+    return u;
+}
+
+// Labels the unlabeled vertices that reach root in the residual graph with
+// height[root] plus their distance to it, by a level-synchronous parallel BFS
+template <class P>
+inline void backwardBfs(Data<P> *data, int root) {
+    const ResidualGraph *csr = data->csr;
+    data->frontier[0] = root;
+    int nfrontier = 1;
+    for (int L = data->height[root]; nfrontier > 0; L++) {
+        int nnext = 0;
+#pragma omp parallel for num_threads(data->ncpus) schedule(dynamic, 64)
+        for (int k = 0; k < nfrontier; k++) {
+            int u = data->frontier[k];
+            for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+                int v = csr->head[a];
+                if (data->height[v] == INT_MAX && data->residual[csr->rev[a]] > 0 && __sync_bool_compare_and_swap(&data->height[v], INT_MAX, L + 1)) {
+                    int idx;
+#pragma omp atomic capture
+                    idx = nnext++;
+                    data->nextFrontier[idx] = v;
+                }
             }
         }
-        if (idx * 2 <= data->queSize && data->label[data->queue[idx]] > data->label[data->queue[idx * 2]]) {
-            swap(&data->queue[idx], &data->queue[idx * 2]);
-        }
+        int *tmp = data->frontier;
+        data->frontier = data->nextFrontier;
+        data->nextFrontier = tmp;
+        nfrontier = nnext;
     }
-#endif
-#ifdef SPINLOCK
-    pthread_spin_unlock(&data->queLock);
-#else
-    pthread_mutex_unlock(&data->queLock);
-#endif
-    return retVal;
 }
 
-inline void shortestPath(Data *data) {
+// Exact heights from a backward BFS from T on the residual graph. Vertices
+// that cannot reach T take V - 1 plus their distance to S, so that excess
+// left in the second phase is not stranded by repeated global relabels,
+// the rest hold no excess and are lifted to 2V - 1 to keep every arc valid.
+// S is left untouched.
+// Must run while no worker thread is active.
+template <class P>
+inline void globalRelabel(Data<P> *data) {
+    const ResidualGraph *csr = data->csr;
     int V = data->V;
+    int S = data->S;
     int T = data->T;
+    int hS = data->height[S];
+#pragma omp parallel for num_threads(data->ncpus)
     for (int u = 0; u < V; u++) {
         data->height[u] = INT_MAX;
     }
     data->height[T] = 0;
-    std::queue<int> que;
-    que.push(T);
-    while (que.size()) {
-        int u = que.front();
-        que.pop();
-        for (int i = 0; i < data->nedge[u]; i++) {
-            int v = data->edge[u * V + i];
-            if (data->height[v] == INT_MAX && data->residual[u * V + v] > 0) {
-                data->height[v] = data->height[u] + 1;
-                que.push(v);
-            }
-        }
+    data->height[S] = 0;  // Kept out of the search from T
+    backwardBfs(data, T);
+    data->height[S] = V - 1;
+    backwardBfs(data, S);
+    data->height[S] = hS;
+#pragma omp parallel for num_threads(data->ncpus)
+    for (int u = 0; u < V; u++) {
+        data->heightCnt[u] = 0;
+        if (data->height[u] == INT_MAX)
+            data->height[u] = 2 * V - 1;
+        data->current[u] = csr->offset[u];
+    }
+#pragma omp parallel for num_threads(data->ncpus)
+    for (int u = 0; u < V; u++) {
+        if (u != S && data->height[u] < V)
+            __sync_fetch_and_add(&data->heightCnt[data->height[u]], 1);
     }
+    if (P::Queue::heightKeyed)
+        data->que.rebuild();
+    data->work = 0;
+    data->gapPending = 0;
 }
 
-// applies if excess[u] > 0, residual[u * V + v] > 0, and height[u] = height[v] + 1
-inline void push(Data *data, int u, int v) {
+// Lifts every vertex above the lowest empty height to V.
+// Counters are only exact while no worker thread is active, so relabel just flags
+// the gap and the lift runs between worker rounds.
+template <class P>
+inline void gapRelabel(Data<P> *data) {
     int V = data->V;
-    int delta = min(data->excess[u], data->residual[u * V + v]);
-    data->residual[u * V + v] -= delta;
-    data->residual[v * V + u] += delta;
+    int S = data->S;
+    int g = 0;
+    while (g < V && data->heightCnt[g] > 0)
+        g++;
+#pragma omp parallel for num_threads(data->ncpus)
+    for (int v = 0; v < V; v++) {
+        if (v != S && data->height[v] > g && data->height[v] < V) {
+            __sync_fetch_and_sub(&data->heightCnt[data->height[v]], 1);
+            data->height[v] = V;
+            data->current[v] = data->csr->offset[v];
+        }
+    }
+    if (P::Queue::heightKeyed)
+        data->que.rebuild();
+    data->gapPending = 0;
+}
+
+// applies if excess[u] > 0, residual[a] > 0, and height[u] = height[v] + 1 for arc a = (u,v)
+template <class P>
+inline void push(Data<P> *data, int u, int a) {
+    int v = data->csr->head[a];
+    int delta = min(data->excess[u], data->residual[a]);
+    data->residual[a] -= delta;
+    data->residual[data->csr->rev[a]] += delta;
     data->excess[u] -= delta;
     data->excess[v] += delta;
+    STATS_ADD(pushes, 1);
+    STATS_ADD(saturatingPushes, data->residual[a] == 0);
     if (!data->inqueue[v] && v != data->S && v != data->T) {
         data->inqueue[v] = 1;
         quePush(data, v);
     }
 }
 
-// applies if excess[u] > 0 and if height[u] < height[v] for all (u,v) residual[u * V + v] > 0
-inline void relabel(Data *data, int u) {
+// Sets height[u] and keeps the relabel work and height counters up to date
+template <class P>
+inline void setHeight(Data<P> *data, int u, int newHeight) {
+    const ResidualGraph *csr = data->csr;
     int V = data->V;
+    int oldHeight = data->height[u];
+    __atomic_store_n(&data->height[u], newHeight, __ATOMIC_RELAXED);
+    STATS_ADD(relabels, 1);
+    __sync_fetch_and_add(&data->work, GLOBAL_RELABEL_BETA + csr->offset[u + 1] - csr->offset[u]);
+    if (newHeight != oldHeight) {
+        if (newHeight < V)
+            __sync_fetch_and_add(&data->heightCnt[newHeight], 1);
+        if (oldHeight < V && __sync_sub_and_fetch(&data->heightCnt[oldHeight], 1) == 0)
+            data->gapPending = 1;
+    }
+}
+
+// applies if excess[u] > 0 and if height[u] <= height[v] for all arcs a = (u,v) with residual[a] > 0
+template <class P>
+inline void relabel(Data<P> *data, int u) {
+    const ResidualGraph *csr = data->csr;
     int minHeight = INT_MAX;
-    for (int i = 0; i < data->nedge[u]; i++) {
-        int v = data->edge[u * V + i];
-        if (data->residual[u * V + v] > 0)
-            minHeight = min(minHeight, data->height[v]);
+    for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+        if (data->residual[a] > 0)
+            minHeight = min(minHeight, data->height[csr->head[a]]);
     }
-    data->height[u] = minHeight + 1;
+    setHeight(data, u, minHeight + 1);
 }
 
-inline void discharge(Data *data, int u) {
-    int V = data->V;
+// Sets u aside until phase 2, it cannot reach T any more. The caller owns u.
+template <class P>
+inline void defer(Data<P> *data, int u) {
+    data->deferred[__sync_fetch_and_add(&data->nDeferred, 1)] = u;
+}
+
+// Pushes along the current arc until u has no excess, relabels only once every
+// arc of u has been found not admissible. Neighbor heights only rise while
+// workers run, so skipped arcs stay not admissible until u itself is relabeled.
+template <class P>
+inline void discharge(Data<P> *data, int u) {
+    const ResidualGraph *csr = data->csr;
+    int end = csr->offset[u + 1];
     bool done = false;
     while (!done) {
         // Lock inside discharge to prevent holding
-#ifdef SPINLOCK
-        pthread_spin_lock(&data->vertexLock[u]);
-#else
-        pthread_mutex_lock(&data->vertexLock[u]);
-#endif
-        relabel(data, u);
-        for (int i = 0; i < data->nedge[u]; i++) {
-            int v = data->edge[u * V + i];
-            if (data->height[u] > data->height[v] && data->residual[u * V + v] > 0) {
-                // Use trylock to prevent deadlock
-                int err;
-#ifdef SPINLOCK
-                err = pthread_spin_trylock(&data->vertexLock[v]);
-#else
-                err = pthread_mutex_trylock(&data->vertexLock[v]);
-#endif
-                if (err == 0) {
-                    push(data, u, v);
-#ifdef SPINLOCK
-                    pthread_spin_unlock(&data->vertexLock[v]);
-#else
-                    pthread_mutex_unlock(&data->vertexLock[v]);
-#endif
-                    if (data->excess[u] == 0) {
-                        data->inqueue[u] = 0;
-                        done = true;
-                        break;
-                    }
+        TRACE_ACQUIRE(data->vertexLock[u], u);
+        for (;;) {
+            if (data->excess[u] == 0) {
+                data->inqueue[u] = 0;
+                done = true;
+                break;
+            }
+            int a = data->current[u];
+            if (a == end) {
+                relabel(data, u);
+                data->current[u] = csr->offset[u];
+                if (data->phase1 && data->height[u] >= data->V) {
+                    defer(data, u);
+                    done = true;
+                    break;
+                }
+                continue;
+            }
+            int v = csr->head[a];
+            if (data->height[u] > data->height[v] && data->residual[a] > 0) {
+                // Use trylock to prevent deadlock, release u and retry the arc on failure
+                if (!data->vertexLock[v].tryAcquire()) {
+                    STATS_ADD(tryLockFails, 1);
+                    break;
                 }
+                push(data, u, a);
+                data->vertexLock[v].release();
+            } else {
+                data->current[u]++;
             }
         }
-#ifdef SPINLOCK
-        pthread_spin_unlock(&data->vertexLock[u]);
-#else
-        pthread_mutex_unlock(&data->vertexLock[u]);
-#endif
+        data->vertexLock[u].release();
     }
 }
 
-void *pushRelabelThread(void *arg) {
-    Data *data = (Data *)arg;
+// Lock-free discharge after Hong, "A lock-free multi-threaded algorithm for the
+// maximum flow problem". The thread that popped u owns it while inqueue[u] is
+// set: only the owner lowers excess[u] and residual on arcs out of u, or writes
+// height[u]. Other threads only add to them atomically, so a push never
+// overdraws and relabel reads neighbor heights without locks.
+template <class P>
+inline void dischargeLockFree(Data<P> *data, int u) {
+    const ResidualGraph *csr = data->csr;
     int S = data->S;
     int T = data->T;
-    for (int u; (u = quePop(data)) != -1;) {
-        data->vertexCnt[u]++;
-        if (u != S && u != T)
-            discharge(data, u);
+    for (;;) {
+        int e = __atomic_load_n(&data->excess[u], __ATOMIC_ACQUIRE);
+        if (e == 0) {
+            // Release u, then take it back if a concurrent push raced the release
+            __atomic_store_n(&data->inqueue[u], 0, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&data->excess[u], __ATOMIC_SEQ_CST) == 0 || !__sync_bool_compare_and_swap(&data->inqueue[u], 0, 1))
+                return;
+            continue;
+        }
+        // Lowest neighbor over residual arcs
+        int minHeight = INT_MAX;
+        int minArc = -1;
+        for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+            if (__atomic_load_n(&data->residual[a], __ATOMIC_RELAXED) > 0) {
+                int h = __atomic_load_n(&data->height[csr->head[a]], __ATOMIC_RELAXED);
+                if (h < minHeight) {
+                    minHeight = h;
+                    minArc = a;
+                }
+            }
+        }
+        if (data->height[u] > minHeight) {
+            int v = csr->head[minArc];
+            int r = __atomic_load_n(&data->residual[minArc], __ATOMIC_RELAXED);
+            int delta = min(e, r);
+            __sync_fetch_and_sub(&data->residual[minArc], delta);
+            __sync_fetch_and_add(&data->residual[csr->rev[minArc]], delta);
+            __sync_fetch_and_sub(&data->excess[u], delta);
+            __sync_fetch_and_add(&data->excess[v], delta);
+            STATS_ADD(pushes, 1);
+            STATS_ADD(saturatingPushes, delta == r);
+            if (v != S && v != T && __sync_bool_compare_and_swap(&data->inqueue[v], 0, 1))
+                quePush(data, v);
+        } else {
+            setHeight(data, u, minHeight + 1);
+            if (data->phase1 && minHeight + 1 >= data->V) {
+                defer(data, u);
+                return;
+            }
+        }
     }
-    return NULL;
 }
-}  // namespace PPR
-using namespace PPR;
 
-void ParallelPushRelabel(Graph *graph, int *flow) {
-    Data *data = (Data *)malloc(sizeof(Data));
-    int V = data->V = graph->V;
-    int S = data->S = graph->S;
-    data->T = graph->T;
-    data->ncpus = graph->ncpus;
-    data->edge = (int *)malloc(sizeof(int) * V * V);
-    data->nedge = (int *)malloc(sizeof(int) * V);
-    data->excess = (int *)malloc(sizeof(int) * V);
-    data->residual = (int *)malloc(sizeof(int) * V * V);
-    data->height = (int *)malloc(sizeof(int) * V);
-    data->inqueue = (int *)malloc(sizeof(int) * data->V);
-    data->vertexCnt = (int *)malloc(sizeof(int) * data->V);
-#if QTYPE == 0 || QTYPE == 1 || QTYPE == 2 || QTYPE == 3 || QTYPE == 4
-    data->queue = (int *)malloc(sizeof(int) * (data->V + 1));
-    data->queSize = 0;
-#endif
-#if QTYPE == 0
-    data->queFront = 0;
-    data->queBack = 0;
-#elif QTYPE == 1
-    data->label = data->height;
-#elif QTYPE == 2
-    data->label = (int *)malloc(sizeof(int) * data->V);  // Distance
-#elif QTYPE == 3
-    data->label = (int *)malloc(sizeof(int) * data->V);  // Separates layer
-#elif QTYPE == 4
-    data->label = data->vertexCnt;  // Appearance
-#endif
-#ifdef SPINLOCK
-    data->vertexLock = (pthread_spinlock_t *)malloc(sizeof(pthread_spinlock_t) * V);
-#else
-    data->vertexLock = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t) * V);
-#endif
-    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * data->ncpus);
-    for (int u = 0; u < V; u++) {
-#ifdef SPINLOCK
-        pthread_spin_init(&data->vertexLock[u], 0);
-#else
-        pthread_mutex_init(&data->vertexLock[u], 0);
-#endif
-    }
-#ifdef SPINLOCK
-    pthread_spin_init(&data->queLock, 0);
-#else
-    pthread_mutex_init(&data->queLock, 0);
-#endif
+// Stop all workers for a global or gap relabel
+template <class P>
+inline bool stopRequested(Data<P> *data) {
+    return __atomic_load_n(&data->work, __ATOMIC_RELAXED) > data->workLimit || __atomic_load_n(&data->gapPending, __ATOMIC_RELAXED);
+}
 
-    TIMING_START(_init);
-    {
-        for (int u = 0; u < V; u++) {
-            for (int v = 0; v < V; v++) {
-                data->residual[u * V + v] = 0;
-            }
+// Waits for work while other workers may still activate vertices. A worker only
+// goes idle after its pop failed, and only busy workers push, so once every
+// worker is idle the queue is empty for good.
+template <class P>
+inline int idle(Data<P> *data) {
+    __sync_fetch_and_sub(&data->busy, 1);
+    for (;;) {
+        if (__atomic_load_n(&data->busy, __ATOMIC_ACQUIRE) == 0 || stopRequested(data))
+            return -1;
+        if (!data->que.empty()) {
+            __sync_fetch_and_add(&data->busy, 1);
+            int u = quePop(data);
+            if (u != -1)
+                return u;
+            __sync_fetch_and_sub(&data->busy, 1);
+        } else {
+            STATS_ADD(emptyPolls, 1);
         }
-        for (int u = 0; u < V; u++) {
-            data->nedge[u] = 0;
+        sched_yield();
+    }
+}
+
+template <class P>
+inline void pushRelabelThread(Data<P> *data) {
+    int S = data->S;
+    int T = data->T;
+    for (int u; !stopRequested(data);) {
+        if ((u = quePop(data)) == -1) {
+            TRACE_BEGIN(idle);
+            u = idle(data);
+            TRACE_END(idle, TRACE_IDLE, -1);
+            if (u == -1)
+                break;
         }
-        for (int u = 0; u < V; u++) {
-            for (int i = 0; i < (int)graph->edge[u].size(); i++) {
-                int v = graph->edge[u][i].first;
-                data->edge[u * V + data->nedge[u]++] = v;
-                data->edge[v * V + data->nedge[v]++] = u;
-                data->residual[u * V + v] = graph->edge[u][i].second;
-            }
+        if (data->phase1 && data->height[u] >= data->V) {
+            defer(data, u);
+            continue;
         }
-        for (int u = 0; u < V; u++) {
-            data->excess[u] = 0;
-            data->height[u] = 0;
-            data->inqueue[u] = 0;
-            data->vertexCnt[u] = 0;
+        data->vertexCnt[u]++;
+        if (u != S && u != T) {
+            STATS_ADD(discharges, 1);
+            TRACE_BEGIN(discharge);
+            if (P::lockFree)
+                dischargeLockFree(data, u);
+            else
+                discharge(data, u);
+            TRACE_END(discharge, TRACE_DISCHARGE, u);
         }
     }
-    TIMING_END(_init);
+}
 
-    TIMING_START(_shortest_path);
-    {
-        shortestPath(data);
+// Pool thread, runs one worker round per pass of the start barrier until quit.
+// The barriers also order the main thread's writes to data before every round.
+template <class P>
+void *workerThread(void *arg) {
+    Data<P> *data = ((Worker<P> *)arg)->data;
+    QUE::queId = ((Worker<P> *)arg)->tid;
+    STATS_THREAD(&data->counters[QUE::queId]);
+    TRACE_THREAD(QUE::queId);
+    for (;;) {
+        pthread_barrier_wait(&data->roundStart);
+        if (data->quit)
+            return NULL;
+        pushRelabelThread(data);
+        pthread_barrier_wait(&data->roundEnd);
     }
-    TIMING_END(_shortest_path);
+}
 
-#if QTYPE == 2
-    {
-        for (int u = 0; u < V; u++) {
-            data->label[u] = data->height[u];
+// Runs worker rounds until no active vertex is left, with global and gap
+// relabels between rounds
+template <class P>
+inline void runWorkers(Data<P> *data) {
+    do {
+        data->busy = data->ncpus;
+        pthread_barrier_wait(&data->roundStart);
+        pthread_barrier_wait(&data->roundEnd);
+        TRACE_BEGIN(relabel);
+        if (data->work > data->workLimit) {
+            globalRelabel(data);
+            TRACE_END(relabel, TRACE_GLOBAL_RELABEL, -1);
+        } else if (data->gapPending) {
+            gapRelabel(data);
+            TRACE_END(relabel, TRACE_GAP_RELABEL, -1);
         }
+    } while (!data->que.empty());
+}
+
+template <class P>
+inline void carve(Data<P> *data, Arena *arena, int V, int E) {
+    data->cap = data->ownCap ? (int *)arenaAlloc(arena, sizeof(int) * 2 * E) : NULL;
+    data->excess = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->residual = (int *)arenaAlloc(arena, sizeof(int) * 2 * E);
+    data->height = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->current = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->inqueue = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->vertexCnt = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->heightCnt = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->frontier = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->nextFrontier = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->deferred = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->que.carve(arena, V);
+    data->vertexLock = P::lockFree ? NULL : (typename P::Lock *)arenaAlloc(arena, sizeof(typename P::Lock) * V);
+}
+
+// Carves the arena for V vertices and E edges and initializes the vertex locks once
+template <class P>
+inline void reserve(Data<P> *data, int V, int E) {
+    carve(data, &data->arena, V, E);
+    arenaCommit(&data->arena);
+    carve(data, &data->arena, V, E);
+    data->maxV = V;
+    data->maxE = E;
+    for (int u = 0; !P::lockFree && u < V; u++) {
+        data->vertexLock[u].init();
+    }
+}
+
+template <class P>
+inline void release(Data<P> *data) {
+    for (int u = 0; !P::lockFree && u < data->maxV; u++) {
+        data->vertexLock[u].destroy();
+    }
+    arenaFree(&data->arena);
+}
+
+// Allocates the arena for graphs of up to V vertices and E edges and starts
+// the worker pool, which waits at the start barrier between rounds
+template <class P>
+inline Data<P> *create(int V, int E, int ncpus, bool ownCap) {
+    Data<P> *data = (Data<P> *)malloc(sizeof(Data<P>));
+    memset(data, 0, sizeof(Data<P>));
+    data->ncpus = ncpus;
+    data->ownCap = ownCap;
+    reserve(data, V, E);
+    data->queLock.init();
+    data->que.init(ncpus);
+    data->counters = (Counters *)aligned_alloc(64, sizeof(Counters) * (ncpus + 1));
+    data->quit = false;
+    pthread_barrier_init(&data->roundStart, NULL, ncpus + 1);
+    pthread_barrier_init(&data->roundEnd, NULL, ncpus + 1);
+    data->threads = (pthread_t *)malloc(sizeof(pthread_t) * ncpus);
+    data->workers = (Worker<P> *)malloc(sizeof(Worker<P>) * ncpus);
+    for (int tid = 0; tid < ncpus; tid++) {
+        data->workers[tid].data = data;
+        data->workers[tid].tid = tid;
+        pthread_create(&data->threads[tid], 0, workerThread<P>, &data->workers[tid]);
+    }
+    return data;
+}
+
+// Points data at max flows from S to T on csr, the arena grows if csr does not fit
+template <class P>
+inline void bind(Data<P> *data, const ResidualGraph *csr, int S, int T) {
+    if (csr->V > data->maxV || csr->E > data->maxE) {
+        int V = csr->V > data->maxV ? csr->V : data->maxV;
+        int E = csr->E > data->maxE ? csr->E : data->maxE;
+        release(data);
+        reserve(data, V, E);
+    }
+    data->V = csr->V;
+    data->S = S;
+    data->T = T;
+    data->csr = csr;
+    if (data->ownCap)
+        memcpy(data->cap, csr->cap, sizeof(int) * 2 * csr->E);
+    else
+        data->cap = csr->cap;
+}
+
+// Zero flow, all vertices inactive, every queue empty
+template <class P>
+inline void initialize(Data<P> *data) {
+    int V = data->V;
+    const ResidualGraph *csr = data->csr;
+    memcpy(data->residual, data->cap, sizeof(int) * 2 * csr->E);
+    for (int u = 0; u < V; u++) {
+        data->excess[u] = 0;
+        data->height[u] = 0;
+        data->inqueue[u] = 0;
+        data->vertexCnt[u] = 0;
     }
-#elif QTYPE == 3
+    data->que.reset(V, data->height, data->vertexCnt);
+    memset(data->counters, 0, sizeof(Counters) * (data->ncpus + 1));
+    STATS_THREAD(&data->counters[data->ncpus]);
+    TRACE_THREAD(data->ncpus);
+    data->work = 0;
+    data->phase1 = 1;
+    data->nDeferred = 0;
+    data->workLimit = GLOBAL_RELABEL_FREQ > 0 ? (GLOBAL_RELABEL_ALPHA * (long long)V + 2LL * csr->E) / GLOBAL_RELABEL_FREQ : 0x7fffffffffffffffLL;
+}
+
+// Zero flow, exact heights and the preflow out of S
+template <class P>
+inline void start(Data<P> *data) {
+    const ResidualGraph *csr = data->csr;
+    int V = data->V;
+    int S = data->S;
+
+    TIMING_START(_init);
     {
-        std::vector<int> num(V, 0);
-        for (int u = 0; u < V; u++) {
-            data->label[u] = num[data->height[u]]++;
-        }
+        initialize(data);
+    }
+    TIMING_END(_init);
+
+    TIMING_START(_shortest_path);
+    {
+        globalRelabel(data);
     }
-#endif
+    TIMING_END(_shortest_path);
+
+    data->que.initLabel();
 
     TIMING_START(_preflow);
     {
         data->height[S] = V - 1;
         data->excess[S] = INT_MAX;
-        for (int i = 0; i < data->nedge[S]; i++) {
-            int v = data->edge[S * V + i];
-            if (data->residual[S * V + v] > 0) {
-                push(data, S, v);
+        for (int a = csr->offset[S]; a < csr->offset[S + 1]; a++) {
+            if (data->residual[a] > 0) {
+                push(data, S, a);
             }
         }
     }
     TIMING_END(_preflow);
+}
+
+// Phase 1 until the min cut is fixed, then phase 2 back to a flow, as in PR::solve
+template <class P>
+inline int solve(Data<P> *data, int *flow, char *cut) {
+    const ResidualGraph *csr = data->csr;
+    int V = data->V;
+    int S = data->S;
+    STATS_THREAD(&data->counters[data->ncpus]);
+    // Vertices set aside by an earlier cut-only solve of a session are active again
+    data->phase1 = 1;
+    for (int k = 0; k < data->nDeferred; k++) {
+        quePush(data, data->deferred[k]);
+    }
+    data->nDeferred = 0;
 
     TIMING_START(_innerPushRelabel);
     {
-        for (int tid = 0; tid < data->ncpus; tid++) {
-            pthread_create(&threads[tid], 0, pushRelabelThread, data);
-        }
-        for (int tid = 0; tid < data->ncpus; tid++) {
-            pthread_join(threads[tid], NULL);
-        }
+        runWorkers(data);
     }
     TIMING_END(_innerPushRelabel);
 
-    TIMING_START(_flow);
-    {
+    if (cut) {
+        TIMING_START(_minCut);
+        // Exact heights, every vertex that cannot reach T is lifted to V
+        globalRelabel(data);
+#pragma omp parallel for num_threads(data->ncpus)
         for (int u = 0; u < V; u++) {
-            for (int i = 0; i < (int)graph->edge[u].size(); i++) {
-                int v = graph->edge[u][i].first;
-                flow[u * V + v] = graph->edge[u][i].second - data->residual[u * V + v];
+            cut[u] = u == S || data->height[u] >= V;
+        }
+        TIMING_END(_minCut);
+    }
+
+    if (flow) {
+        TIMING_START(_returnExcess);
+        {
+            data->phase1 = 0;
+            for (int k = 0; k < data->nDeferred; k++) {
+                quePush(data, data->deferred[k]);
             }
+            data->nDeferred = 0;
+            runWorkers(data);
         }
+        TIMING_END(_returnExcess);
+
+        TIMING_START(_flow);
+        {
+            for (int i = 0; i < csr->E; i++) {
+                int a = csr->arc[i];
+                flow[i] = data->cap[a] - data->residual[a];
+            }
+        }
+        TIMING_END(_flow);
     }
-    TIMING_END(_flow);
 
     {
         // Profile
@@ -398,34 +650,230 @@ void ParallelPushRelabel(Graph *graph, int *flow) {
         printf(" Max cnt: %d\n", maxcnt);
         printf(" Min cnt: %d\n", mincnt);
         printf(" Max Flow: %d\n", data->excess[data->T]);
+        STATS_MERGE(data->counters, data->ncpus + 1);
     }
+    return data->excess[data->T];
+}
 
-    for (int u = 0; u < V; u++) {
-#ifdef SPINLOCK
-        pthread_spin_destroy(&data->vertexLock[u]);
-#else
-        pthread_mutex_destroy(&data->vertexLock[u]);
-#endif
-    }
-#ifdef SPINLOCK
-    pthread_spin_destroy(&data->queLock);
-#else
-    pthread_mutex_destroy(&data->queLock);
-#endif
-    free(data->edge);
-    free(data->nedge);
-    free(data->excess);
-    free(data->residual);
-    free(data->height);
-    free(data->inqueue);
-    free(data->vertexCnt);
-#if QTYPE == 0 || QTYPE == 1 || QTYPE == 2 || QTYPE == 3 || QTYPE == 4
-    free(data->queue);
-#endif
-#if QTYPE == 2 || QTYPE == 3
-    free(data->label);
-#endif
-    free((void *)data->vertexLock);
+// Queues u if it holds excess and is not queued yet
+template <class P>
+inline void activate(Data<P> *data, int u) {
+    if (!data->inqueue[u] && data->excess[u] > 0 && u != data->S && u != data->T) {
+        data->inqueue[u] = 1;
+        quePush(data, u);
+    }
+}
+
+// Sets new capacities and repairs the flow of the last solve into a preflow
+// with valid heights, as PR::update does. Runs on the main thread while the
+// workers wait at the start barrier. The current arc of every vertex with an
+// arc that gained residual capacity is rewound, that arc may be admissible now.
+template <class P>
+inline void update(Data<P> *data, int n, const int *edge, const int *cap) {
+    const ResidualGraph *csr = data->csr;
+    int S = data->S;
+    int T = data->T;
+    // Each warm solve schedules global relabels and reports counts of its own
+    memset(data->counters, 0, sizeof(Counters) * (data->ncpus + 1));
+    STATS_THREAD(&data->counters[data->ncpus]);
+    memset(data->vertexCnt, 0, sizeof(int) * data->V);
+    data->work = 0;
+    std::vector<int> touched;  // Arcs that gained residual capacity
+    std::vector<int> deficit;  // Vertices with more outflow than inflow
+    for (int k = 0; k < n; k++) {
+        int a = csr->arc[edge[k]];
+        int r = csr->rev[a];
+        int u = csr->head[r];
+        int v = csr->head[a];
+        int delta = cap[k] - data->cap[a];
+        data->cap[a] = cap[k];
+        data->residual[a] += delta;
+        if (data->residual[a] < 0) {
+            int over = -data->residual[a];
+            data->residual[a] = 0;
+            data->residual[r] -= over;
+            data->excess[u] += over;
+            data->excess[v] -= over;
+            if (v != S && v != T && data->excess[v] < 0 && data->excess[v] + over >= 0)
+                deficit.push_back(v);
+            activate(data, u);
+        } else if (delta > 0) {
+            touched.push_back(a);
+        }
+    }
+
+    // A vertex with negative excess has an outgoing arc with positive flow
+    while (deficit.size()) {
+        int v = deficit.back();
+        deficit.pop_back();
+        for (int a = csr->offset[v]; data->excess[v] < 0 && a < csr->offset[v + 1]; a++) {
+            int f = data->cap[a] - data->residual[a];
+            if (f <= 0)
+                continue;
+            int w = csr->head[a];
+            int delta = min(f, -data->excess[v]);
+            data->residual[a] += delta;
+            data->residual[csr->rev[a]] -= delta;
+            data->excess[v] += delta;
+            data->excess[w] -= delta;
+            touched.push_back(a);
+            if (w != S && w != T && data->excess[w] < 0 && data->excess[w] + delta >= 0)
+                deficit.push_back(w);
+        }
+    }
+
+    bool valid = true;
+    for (int a : touched) {
+        int x = csr->head[csr->rev[a]];
+        data->current[x] = csr->offset[x];
+        if (x != S && data->residual[a] > 0 && data->height[x] > data->height[csr->head[a]] + 1)
+            valid = false;
+    }
+    if (!valid)
+        globalRelabel(data);
+
+    // Arcs out of S that became admissible take all they can, as in the preflow
+    for (int a = csr->offset[S]; a < csr->offset[S + 1]; a++) {
+        if (data->residual[a] > 0 && data->height[S] > data->height[csr->head[a]] + 1)
+            push(data, S, a);
+    }
+}
+
+// Stops the worker pool and frees everything
+template <class P>
+inline void destroy(Data<P> *data) {
+    data->quit = true;
+    pthread_barrier_wait(&data->roundStart);
+    for (int tid = 0; tid < data->ncpus; tid++) {
+        pthread_join(data->threads[tid], NULL);
+    }
+    pthread_barrier_destroy(&data->roundStart);
+    pthread_barrier_destroy(&data->roundEnd);
+    release(data);
+    data->queLock.destroy();
+    data->que.destroy();
+    free(data->counters);
+    free(data->threads);
+    free(data->workers);
     free(data);
-    free(threads);
-}
\ No newline at end of file
+}
+
+// Entry points of one specialization. Sessions call them once per solve,
+// everything below them is inlined for that policy.
+struct Ops {
+    void *(*create)(int V, int E, int ncpus, bool ownCap);
+    void (*bind)(void *data, const ResidualGraph *csr, int S, int T);
+    void (*start)(void *data);
+    int (*solve)(void *data, int *flow, char *cut);
+    void (*update)(void *data, int n, const int *edge, const int *cap);
+    void (*destroy)(void *data);
+};
+
+template <class P>
+struct Engine {
+    static void *create(int V, int E, int ncpus, bool ownCap) {
+        return PPR::create<P>(V, E, ncpus, ownCap);
+    }
+    static void bind(void *data, const ResidualGraph *csr, int S, int T) {
+        PPR::bind((Data<P> *)data, csr, S, T);
+    }
+    static void start(void *data) {
+        PPR::start((Data<P> *)data);
+    }
+    static int solve(void *data, int *flow, char *cut) {
+        return PPR::solve((Data<P> *)data, flow, cut);
+    }
+    static void update(void *data, int n, const int *edge, const int *cap) {
+        PPR::update((Data<P> *)data, n, edge, cap);
+    }
+    static void destroy(void *data) {
+        PPR::destroy((Data<P> *)data);
+    }
+    static const Ops ops;
+};
+
+template <class P>
+const Ops Engine<P>::ops = {create, bind, start, solve, update, destroy};
+
+template <class Queue, class Lock>
+inline const Ops *selectOps(bool lockFree) {
+    if (lockFree)
+        return &Engine<Policy<Queue, Lock, true>>::ops;
+    return &Engine<Policy<Queue, Lock, false>>::ops;
+}
+
+template <class Queue>
+inline const Ops *selectOps(bool spinLock, bool lockFree) {
+    if (spinLock)
+        return selectOps<Queue, LOCK::SpinLock>(lockFree);
+    return selectOps<Queue, LOCK::MutexLock>(lockFree);
+}
+
+inline const Ops *selectOps(int qtype, bool spinLock, bool lockFree) {
+    switch (qtype) {
+        case 0:
+            return selectOps<QUE::Fifo>(spinLock, lockFree);
+        case 1:
+            return selectOps<QUE::Heap<QUE::HEIGHT>>(spinLock, lockFree);
+        case 2:
+            return selectOps<QUE::Heap<QUE::DISTANCE>>(spinLock, lockFree);
+        case 3:
+            return selectOps<QUE::Heap<QUE::LAYER>>(spinLock, lockFree);
+        case 4:
+            return selectOps<QUE::Heap<QUE::APPEARANCE>>(spinLock, lockFree);
+        case 5:
+            return selectOps<QUE::WorkStealing>(spinLock, lockFree);
+        case 6:
+            return selectOps<QUE::Buckets>(spinLock, lockFree);
+        case 7:
+            return selectOps<QUE::MultiQueue>(spinLock, lockFree);
+
+        default:
+            fprintf(stderr, "Unknown queue type %d\n", qtype);
+            exit(EXIT_FAILURE);
+    }
+}
+}  // namespace PPR
+using namespace PPR;
+
+struct ParallelPushRelabelSession {
+    const Ops *ops;
+    void *data;
+};
+
+static ParallelPushRelabelSession *open(int V, int E, int ncpus, int qtype, bool spinLock, bool lockFree, bool ownCap) {
+    ParallelPushRelabelSession *session = (ParallelPushRelabelSession *)malloc(sizeof(ParallelPushRelabelSession));
+    session->ops = selectOps(qtype, spinLock, lockFree);
+    session->data = session->ops->create(V, E, ncpus, ownCap);
+    return session;
+}
+
+ParallelPushRelabelSession *openParallelPushRelabel(Graph *graph, bool lockFree) {
+    ParallelPushRelabelSession *session = open(graph->V, graph->E, graph->ncpus, graph->qtype, graph->spinLock, lockFree, true);
+    session->ops->bind(session->data, &graph->csr, graph->S, graph->T);
+    session->ops->start(session->data);
+    return session;
+}
+
+int solveParallelPushRelabel(ParallelPushRelabelSession *session, int *flow, char *cut) {
+    return session->ops->solve(session->data, flow, cut);
+}
+
+void updateParallelPushRelabel(ParallelPushRelabelSession *session, int n, const int *edge, const int *cap) {
+    session->ops->update(session->data, n, edge, cap);
+}
+
+ParallelPushRelabelSession *openParallelPushRelabel(int V, int E, int ncpus, int qtype, bool spinLock, bool lockFree) {
+    return open(V, E, ncpus, qtype, spinLock, lockFree, false);
+}
+
+int solveParallelPushRelabel(ParallelPushRelabelSession *session, Graph *graph, int *flow, char *cut) {
+    session->ops->bind(session->data, &graph->csr, graph->S, graph->T);
+    session->ops->start(session->data);
+    return session->ops->solve(session->data, flow, cut);
+}
+
+void closeParallelPushRelabel(ParallelPushRelabelSession *session) {
+    session->ops->destroy(session->data);
+    free(session);
+}
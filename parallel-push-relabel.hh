@@ -3,5 +3,21 @@
 
 #include "graph.hh"
 
-void ParallelPushRelabel(Graph *graph, int *flow);
+// Solves one graph after another on one arena, sized for up to V vertices and
+// E edges and grown for a larger graph, and one pool of ncpus worker threads.
+// qtype and spinLock pick the queue and lock policies, lockFree Hong's lock-free
+// discharge instead of vertex locks. Two phases as in solvePushRelabel, flow or
+// cut may be NULL, returns the max flow value.
+struct ParallelPushRelabelSession;
+ParallelPushRelabelSession *openParallelPushRelabel(int V, int E, int ncpus, int qtype, bool spinLock, bool lockFree);
+int solveParallelPushRelabel(ParallelPushRelabelSession *session, Graph *graph, int *flow, char *cut);
+void closeParallelPushRelabel(ParallelPushRelabelSession *session);
+
+// Warm-start session as openPushRelabel, on the policies of graph->qtype and
+// graph->spinLock and a pool of graph->ncpus worker threads. Residual, excess
+// and heights persist between solves, flow and cut as above.
+ParallelPushRelabelSession *openParallelPushRelabel(Graph *graph, bool lockFree);
+int solveParallelPushRelabel(ParallelPushRelabelSession *session, int *flow, char *cut);
+// Sets the capacity of input edge edge[k] to cap[k], the next solve restores the max flow
+void updateParallelPushRelabel(ParallelPushRelabelSession *session, int n, const int *edge, const int *cap);
 #endif  // PARALLEL_PUSH_RELABLE
\ No newline at end of file
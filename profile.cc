@@ -0,0 +1,235 @@
+#include "profile.hh"
+
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace PROF {
+struct Scope {
+    const char *name;
+    int parent;  // -1 at the root
+    int count;
+    double seconds;
+    double minSeconds;
+    double maxSeconds;
+    long long perf[NUM_PERF];
+    double startTime;  // Of the run in progress
+    long long startPerf[NUM_PERF];
+};
+
+Scope scope[PROFILE_MAX_SCOPE];
+int nscope = 0;
+int current = -1;  // Innermost open scope
+// Counters of one thread of the process. Inherited counters only count
+// threads that have exited, so every thread gets its own.
+struct PerfThread {
+    int tid;
+    int fd[NUM_PERF];
+};
+
+PerfThread perfThread[PROFILE_MAX_THREAD];
+int nperfThread = 0;
+bool perfOn = false;
+
+const char *perfName[] = {"cycles", "instructions", "llcMisses", "branchMisses"};
+const unsigned long long perfConfig[NUM_PERF] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+inline double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+inline int openPerf(int tid, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+}
+
+// Opens all counters of thread tid, on failure none are kept and *failed
+// is the counter the kernel refused
+inline bool openThread(int tid, int *failed) {
+    if (nperfThread == PROFILE_MAX_THREAD)
+        return false;
+    PerfThread *t = &perfThread[nperfThread];
+    t->tid = tid;
+    for (int i = 0; i < NUM_PERF; i++) {
+        t->fd[i] = openPerf(tid, perfConfig[i]);
+        if (t->fd[i] == -1) {
+            *failed = i;
+            for (int k = 0; k < i; k++) {
+                close(t->fd[k]);
+            }
+            return false;
+        }
+    }
+    nperfThread++;
+    return true;
+}
+
+// Picks up the threads started since the last scope boundary
+inline void attachThreads() {
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        int tid = atoi(entry->d_name);
+        bool known = tid <= 0;
+        for (int k = 0; !known && k < nperfThread; k++) {
+            known = perfThread[k].tid == tid;
+        }
+        int failed;
+        if (!known)
+            openThread(tid, &failed);  // A thread that already exited is skipped
+    }
+    closedir(dir);
+}
+
+// Counts summed over every thread of the process, each scaled up if the
+// kernel multiplexed the counter. An exited thread keeps its final count.
+inline void readPerf(long long *value) {
+    attachThreads();
+    for (int i = 0; i < NUM_PERF; i++) {
+        value[i] = 0;
+        for (int k = 0; k < nperfThread; k++) {
+            unsigned long long buf[3];  // Value, time enabled, time running
+            if (read(perfThread[k].fd[i], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0)
+                continue;
+            value[i] += buf[2] < buf[1] ? (long long)((double)buf[0] * buf[1] / buf[2]) : (long long)buf[0];
+        }
+    }
+}
+
+// Child of parent called name, added on first use
+inline int find(int parent, const char *name) {
+    for (int i = 0; i < nscope; i++) {
+        if (scope[i].parent == parent && strcmp(scope[i].name, name) == 0)
+            return i;
+    }
+    if (nscope == PROFILE_MAX_SCOPE) {
+        fprintf(stderr, "More than %d timing scopes\n", PROFILE_MAX_SCOPE);
+        exit(EXIT_FAILURE);
+    }
+    Scope *s = &scope[nscope];
+    memset(s, 0, sizeof(Scope));
+    s->name = name;
+    s->parent = parent;
+    return nscope++;
+}
+
+void report(int parent, int depth) {
+    for (int i = 0; i < nscope; i++) {
+        if (scope[i].parent != parent)
+            continue;
+        Scope *s = &scope[i];
+        printf(" %*s%-*s %6d %11.6lfs %11.6lfs %11.6lfs %11.6lfs", 2 * depth, "", 24 - 2 * depth, s->name, s->count, s->seconds, s->seconds / s->count, s->minSeconds, s->maxSeconds);
+        if (perfOn) {
+            double ipc = s->perf[PERF_CYCLES] > 0 ? (double)s->perf[PERF_INSTRUCTIONS] / s->perf[PERF_CYCLES] : 0;
+            double mpki = s->perf[PERF_INSTRUCTIONS] > 0 ? 1000.0 * s->perf[PERF_LLC_MISSES] / s->perf[PERF_INSTRUCTIONS] : 0;
+            printf(" %14lld %6.2lf %8.3lf %12lld", s->perf[PERF_CYCLES], ipc, mpki, s->perf[PERF_BRANCH_MISSES]);
+        }
+        printf("\n");
+        report(i, depth + 1);
+    }
+}
+
+void json(FILE *fp, const char *indent, int parent, char *path, size_t len, bool *comma) {
+    for (int i = 0; i < nscope; i++) {
+        if (scope[i].parent != parent)
+            continue;
+        Scope *s = &scope[i];
+        int n = snprintf(path + len, 1024 - len, "%s%s", len ? "/" : "", s->name);
+        fprintf(fp, "%s\n%s\"%s\": {\"count\": %d, \"seconds\": %.9f, \"min\": %.9f, \"max\": %.9f", *comma ? "," : "", indent, path, s->count, s->seconds, s->minSeconds, s->maxSeconds);
+        for (int k = 0; perfOn && k < NUM_PERF; k++) {
+            fprintf(fp, ", \"%s\": %lld", perfName[k], s->perf[k]);
+        }
+        fprintf(fp, "}");
+        *comma = true;
+        json(fp, indent, i, path, len + n < 1024 ? len + n : 1023, comma);
+        path[len] = '\0';
+    }
+}
+}  // namespace PROF
+
+bool profilePerf() {
+    using namespace PROF;
+    int failed = 0;
+    if (!openThread(syscall(SYS_gettid), &failed)) {
+        fprintf(stderr, "perf_event_open %s: %s, timing only\n", perfName[failed], strerror(errno));
+        return false;
+    }
+    // Starts the OpenMP pool now so that its threads count from the first scope
+#pragma omp parallel
+    {
+#pragma omp barrier
+    }
+    attachThreads();
+    perfOn = true;
+    return true;
+}
+
+void profileStart(const char *name) {
+    using namespace PROF;
+    current = find(current, name);
+    Scope *s = &scope[current];
+    if (perfOn)
+        readPerf(s->startPerf);
+    s->startTime = now();
+}
+
+void profileEnd(const char *name) {
+    using namespace PROF;
+    double end = now();
+    if (current == -1 || strcmp(scope[current].name, name) != 0) {
+        fprintf(stderr, "TIMING_END(%s) does not close TIMING_START(%s)\n", name, current == -1 ? "" : scope[current].name);
+        exit(EXIT_FAILURE);
+    }
+    Scope *s = &scope[current];
+    double seconds = end - s->startTime;
+    if (perfOn) {
+        long long value[NUM_PERF];
+        readPerf(value);
+        for (int i = 0; i < NUM_PERF; i++) {
+            s->perf[i] += value[i] - s->startPerf[i];
+        }
+    }
+    s->minSeconds = s->count == 0 || seconds < s->minSeconds ? seconds : s->minSeconds;
+    s->maxSeconds = s->count == 0 || seconds > s->maxSeconds ? seconds : s->maxSeconds;
+    s->seconds += seconds;
+    s->count++;
+    current = s->parent;
+    printf("%s took %lfs.\n", name, seconds);
+    fflush(stdout);
+}
+
+void profileReport() {
+    using namespace PROF;
+    if (nscope == 0)
+        return;
+    printf(" %-24s %6s %12s %12s %12s %12s", "Scope", "Count", "Total", "Mean", "Min", "Max");
+    if (perfOn)
+        printf(" %14s %6s %8s %12s", "Cycles", "IPC", "LLC/Ki", "BrMisses");
+    printf("\n");
+    report(-1, 0);
+    fflush(stdout);
+}
+
+void profileJson(FILE *fp, const char *indent) {
+    char path[1024] = "";
+    bool comma = false;
+    PROF::json(fp, indent, -1, path, 0, &comma);
+}
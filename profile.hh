@@ -0,0 +1,28 @@
+#ifndef PROFILE
+#define PROFILE
+
+#include <cstdio>
+
+// Phase timer registry behind TIMING_START and TIMING_END. Scopes nest, a
+// scope opened inside another is its child, and a scope that runs again under
+// the same parent adds to the same entry, so repeated solves aggregate. Main
+// thread only.
+#define PROFILE_MAX_SCOPE 64
+#define PROFILE_MAX_THREAD 1024
+
+// Hardware counters read at every scope boundary when profilePerf succeeded
+enum PerfCounter { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_BRANCH_MISSES, NUM_PERF };
+
+// Opens cycles, instructions, LLC misses and branch misses for every thread of
+// the process, summed at each scope boundary. A thread started later gets its
+// own counters at the next boundary, so work it does before that is missed.
+// Returns false with a message if the kernel refuses, timing goes on without them.
+bool profilePerf();
+void profileStart(const char *name);
+// Closes the innermost scope, which must be name, and prints its wall time
+void profileEnd(const char *name);
+// Count, total, mean, min and max wall time and the counters of every scope, as a tree
+void profileReport();
+// The scopes as the members of one JSON object, keyed by their path from the root
+void profileJson(FILE *fp, const char *indent);
+#endif  // PROFILE
@@ -9,31 +9,40 @@
 #include <vector>
 
 #include "graph.hh"
+#include "queue.hh"
+#include "stats.hh"
 #include "utility.hh"
 
 namespace PR {
+template <class Queue>
 struct Data {
     int V;
     int S;
     int T;
     int ncpus;
-    int *edge;
-    int *nedge;
+    const ResidualGraph *csr;
+    int *cap;  // Arc capacities, csr->cap or a private copy in a warm-start session
     int *excess;
     int *residual;
     int *height;
+    int *current;  // Current arc, arcs before it are not admissible
     int *inqueue;
     int *vertexCnt;
-#if QTYPE == 0
-    int *queue;
-    int queSize;
-    int queFront;
-    int queBack;
-#elif QTYPE == 1 || QTYPE == 2 || QTYPE == 3 || QTYPE == 4
-    int *queue;
-    int queSize;
-    int *label;
-#endif
+    int *layer;           // First vertex at each height below V, -1 if none, S excluded
+    int *layerNext;       // Vertices at one height form a doubly-linked list
+    int *layerPrev;       // -1 at the head of a layer
+    int maxLayer;         // No vertex below V is above this height
+    long long work;       // Relabel work since the last global relabel
+    long long workLimit;  // Global relabel threshold
+    bool phase1;          // Vertices at height V or above wait for phase 2
+    int *deferred;        // Active vertices set aside in phase 1, still marked inqueue
+    int nDeferred;
+    Counters *counters;  // Since the last solve, cold or warm
+    bool ownCap;         // cap is a copy in the arena
+    int maxV;            // Vertices and edges the arena is carved for
+    int maxE;
+    Arena arena;
+    Queue que;  // Active vertices, one of the QUE policies
 };
 
 inline int min(int x, int y) {
@@ -43,253 +52,328 @@ inline int min(int x, int y) {
         return y;
 }
 
-inline void swap(int *x, int *y) {
-    int tmp = *x;
-    *x = *y;
-    *y = tmp;
-}
-
-inline void quePush(Data *data, int u) {
-#if QTYPE == 0
-    data->queue[data->queBack] = u;
-    data->queBack = (data->queBack + 1) % data->V;
-    data->queSize++;
-#elif QTYPE == 1 || QTYPE == 2 || QTYPE == 3
-    data->queue[++data->queSize] = u;
-    int idx = data->queSize;
-    while (idx > 1 && data->label[data->queue[idx]] > data->label[data->queue[idx / 2]]) {
-        swap(&data->queue[idx], &data->queue[idx / 2]);
-        idx = idx / 2;
-    }
-#elif QTYPE == 4
-    data->queue[++data->queSize] = u;
-    int idx = data->queSize;
-    while (idx > 1 && data->label[data->queue[idx]] < data->label[data->queue[idx / 2]]) {
-        swap(&data->queue[idx], &data->queue[idx / 2]);
-        idx = idx / 2;
-    }
-#endif
-}
-
-inline int quePop(Data *data) {
-    int retVal = -1;
-#if QTYPE == 0
-    if (data->queSize > 0) {
-        retVal = data->queue[data->queFront];
-        data->queFront = (data->queFront + 1) % data->V;
-        data->queSize--;
-    }
-#elif QTYPE == 1 || QTYPE == 2 || QTYPE == 3
-    if (data->queSize > 0) {
-        retVal = data->queue[1];
-        data->queue[1] = data->queue[data->queSize--];
-        int idx = 1;
-        while (idx * 2 + 1 <= data->queSize && (data->label[data->queue[idx]] < data->label[data->queue[idx * 2]] || data->label[data->queue[idx]] < data->label[data->queue[idx * 2 + 1]])) {
-            if (data->label[data->queue[idx * 2]] > data->label[data->queue[idx * 2 + 1]]) {
-                swap(&data->queue[idx], &data->queue[idx * 2]);
-                idx = idx * 2;
-            } else {
-                swap(&data->queue[idx], &data->queue[idx * 2 + 1]);
-                idx = idx * 2 + 1;
+// Labels the unlabeled vertices that reach root in the residual graph with
+// height[root] plus their distance to it
+template <class Queue>
+inline void backwardBfs(Data<Queue> *data, int root) {
+    const ResidualGraph *csr = data->csr;
+    std::queue<int> que;
+    que.push(root);
+    while (que.size()) {
+        int u = que.front();
+        que.pop();
+        for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+            int v = csr->head[a];
+            if (data->height[v] == INT_MAX && data->residual[csr->rev[a]] > 0) {
+                data->height[v] = data->height[u] + 1;
+                que.push(v);
             }
         }
-        if (idx * 2 <= data->queSize && data->label[data->queue[idx]] < data->label[data->queue[idx * 2]]) {
-            swap(&data->queue[idx], &data->queue[idx * 2]);
-        }
     }
-#elif QTYPE == 4
-    if (data->queSize > 0) {
-        retVal = data->queue[1];
-        data->queue[1] = data->queue[data->queSize--];
-        int idx = 1;
-        while (idx * 2 + 1 <= data->queSize && (data->label[data->queue[idx]] > data->label[data->queue[idx * 2]] || data->label[data->queue[idx]] > data->label[data->queue[idx * 2 + 1]])) {
-            if (data->label[data->queue[idx * 2]] < data->label[data->queue[idx * 2 + 1]]) {
-                swap(&data->queue[idx], &data->queue[idx * 2]);
-                idx = idx * 2;
-            } else {
-                swap(&data->queue[idx], &data->queue[idx * 2 + 1]);
-                idx = idx * 2 + 1;
-            }
-        }
-        if (idx * 2 <= data->queSize && data->label[data->queue[idx]] > data->label[data->queue[idx * 2]]) {
-            swap(&data->queue[idx], &data->queue[idx * 2]);
-        }
-    }
-#endif
-    return retVal;
 }
 
-inline void shortestPath(Data *data) {
+// Puts u in the layer of its height, unless it is S or at V or above
+template <class Queue>
+inline void layerAdd(Data<Queue> *data, int u) {
+    int h = data->height[u];
+    if (u == data->S || h >= data->V)
+        return;
+    data->layerPrev[u] = -1;
+    data->layerNext[u] = data->layer[h];
+    if (data->layer[h] != -1)
+        data->layerPrev[data->layer[h]] = u;
+    data->layer[h] = u;
+    if (h > data->maxLayer)
+        data->maxLayer = h;
+}
+
+// Takes u out of layer h, the height it was added at
+template <class Queue>
+inline void layerRemove(Data<Queue> *data, int u, int h) {
+    int prev = data->layerPrev[u];
+    int next = data->layerNext[u];
+    if (prev == -1)
+        data->layer[h] = next;
+    else
+        data->layerNext[prev] = next;
+    if (next != -1)
+        data->layerPrev[next] = prev;
+}
+
+// Exact heights from a backward BFS from T on the residual graph. Vertices
+// that cannot reach T take V - 1 plus their distance to S, so that excess
+// left in the second phase is not stranded by repeated global relabels,
+// the rest hold no excess and are lifted to 2V - 1 to keep every arc valid.
+// S is left untouched.
+template <class Queue>
+inline void globalRelabel(Data<Queue> *data) {
+    const ResidualGraph *csr = data->csr;
     int V = data->V;
+    int S = data->S;
     int T = data->T;
+    int hS = data->height[S];
     for (int u = 0; u < V; u++) {
         data->height[u] = INT_MAX;
     }
     data->height[T] = 0;
-    std::queue<int> que;
-    que.push(T);
-    while (que.size()) {
-        int u = que.front();
-        que.pop();
-        for (int i = 0; i < data->nedge[u]; i++) {
-            int v = data->edge[u * V + i];
-            if (data->height[v] == INT_MAX && data->residual[u * V + v] > 0) {
-                data->height[v] = data->height[u] + 1;
-                que.push(v);
-            }
-        }
+    data->height[S] = 0;  // Kept out of the search from T
+    backwardBfs(data, T);
+    data->height[S] = V - 1;
+    backwardBfs(data, S);
+    data->height[S] = hS;
+    for (int u = 0; u < V; u++) {
+        if (data->height[u] == INT_MAX)
+            data->height[u] = 2 * V - 1;
+        data->current[u] = csr->offset[u];
     }
+    memset(data->layer, -1, sizeof(int) * V);
+    data->maxLayer = -1;
+    for (int u = 0; u < V; u++) {
+        layerAdd(data, u);
+    }
+    if (Queue::heightKeyed)
+        data->que.rebuild();
+    data->work = 0;
 }
 
-// applies if excess[u] > 0, residual[u * V + v] > 0, and height[u] = height[v] + 1
-inline void push(Data *data, int u, int v) {
+// No vertex is left at height g, so vertices above it cannot reach T, lift them
+// to V. Only the layers above g are visited, and only the lifted vertices that
+// are queued move in a height-keyed queue.
+template <class Queue>
+inline void gapRelabel(Data<Queue> *data, int g) {
     int V = data->V;
-    int delta = min(data->excess[u], data->residual[u * V + v]);
-    data->residual[u * V + v] -= delta;
-    data->residual[v * V + u] += delta;
+    for (int h = g + 1; h <= data->maxLayer; h++) {
+        for (int v = data->layer[h]; v != -1; v = data->layerNext[v]) {
+            data->height[v] = V;
+            data->current[v] = data->csr->offset[v];
+            if (Queue::heightKeyed)
+                data->que.raise(v, h);
+        }
+        data->layer[h] = -1;
+    }
+    data->maxLayer = g - 1;
+}
+
+// applies if excess[u] > 0, residual[a] > 0, and height[u] = height[v] + 1 for arc a = (u,v)
+template <class Queue>
+inline void push(Data<Queue> *data, int u, int a) {
+    int v = data->csr->head[a];
+    int delta = min(data->excess[u], data->residual[a]);
+    data->residual[a] -= delta;
+    data->residual[data->csr->rev[a]] += delta;
     data->excess[u] -= delta;
     data->excess[v] += delta;
+    STATS_ADD(pushes, 1);
+    STATS_ADD(saturatingPushes, data->residual[a] == 0);
     if (!data->inqueue[v] && v != data->S && v != data->T) {
         data->inqueue[v] = 1;
-        quePush(data, v);
+        data->que.push(v);
     }
 }
 
-// applies if excess[u] > 0 and if height[u] < height[v] for all (u,v) residual[u * V + v] > 0
-inline void relabel(Data *data, int u) {
-    int V = data->V;
+// applies if excess[u] > 0 and if height[u] <= height[v] for all arcs a = (u,v) with residual[a] > 0
+template <class Queue>
+inline void relabel(Data<Queue> *data, int u) {
+    const ResidualGraph *csr = data->csr;
     int minHeight = INT_MAX;
-    for (int i = 0; i < data->nedge[u]; i++) {
-        int v = data->edge[u * V + i];
-        if (data->residual[u * V + v] > 0)
-            minHeight = min(minHeight, data->height[v]);
+    for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+        if (data->residual[a] > 0)
+            minHeight = min(minHeight, data->height[csr->head[a]]);
+    }
+    int V = data->V;
+    int oldHeight = data->height[u];
+    int newHeight = minHeight + 1;
+    data->work += GLOBAL_RELABEL_BETA + csr->offset[u + 1] - csr->offset[u];
+    STATS_ADD(relabels, 1);
+    if (newHeight == oldHeight)
+        return;
+    if (oldHeight < V)
+        layerRemove(data, u, oldHeight);
+    if (oldHeight < V && data->layer[oldHeight] == -1) {
+        data->height[u] = newHeight > V ? newHeight : V;
+        gapRelabel(data, oldHeight);
+    } else {
+        data->height[u] = newHeight;
+        layerAdd(data, u);
     }
-    data->height[u] = minHeight + 1;
 }
 
-inline void discharge(Data *data, int u) {
-    int V = data->V;
-    bool done = false;
-    while (!done) {
-        relabel(data, u);
-        for (int i = 0; i < data->nedge[u]; i++) {
-            int v = data->edge[u * V + i];
-            if (data->height[u] > data->height[v] && data->residual[u * V + v] > 0) {
-                push(data, u, v);
-                if (data->excess[u] == 0) {
-                    data->inqueue[u] = 0;
-                    done = true;
-                    break;
-                }
+// Sets u aside until phase 2, it cannot reach T any more
+template <class Queue>
+inline void defer(Data<Queue> *data, int u) {
+    data->deferred[data->nDeferred++] = u;
+}
+
+// Pushes along the current arc until u has no excess, relabels only once every
+// arc of u has been found not admissible
+template <class Queue>
+inline void discharge(Data<Queue> *data, int u) {
+    const ResidualGraph *csr = data->csr;
+    int end = csr->offset[u + 1];
+    while (data->excess[u] > 0) {
+        int a = data->current[u];
+        if (a == end) {
+            relabel(data, u);
+            data->current[u] = csr->offset[u];
+            if (data->phase1 && data->height[u] >= data->V) {
+                defer(data, u);
+                return;
             }
+            continue;
         }
+        int v = csr->head[a];
+        if (data->height[u] > data->height[v] && data->residual[a] > 0)
+            push(data, u, a);
+        else
+            data->current[u]++;
     }
+    data->inqueue[u] = 0;
 }
 
-void *pushRelabelThread(void *arg) {
-    Data *data = (Data *)arg;
+template <class Queue>
+inline void pushRelabelThread(Data<Queue> *data) {
     int S = data->S;
     int T = data->T;
-    for (int u; (u = quePop(data)) != -1;) {
+    for (int u; (u = data->que.pop()) != -1;) {
+        STATS_ADD(pops, 1);
+        if (data->phase1 && data->height[u] >= data->V) {
+            defer(data, u);
+            continue;
+        }
         data->vertexCnt[u]++;
-        if (u != S && u != T)
+        if (u != S && u != T) {
+            STATS_ADD(discharges, 1);
             discharge(data, u);
+        }
+        if (data->work > data->workLimit)
+            globalRelabel(data);
     }
-    return NULL;
+    STATS_ADD(emptyPolls, 1);
+}
+
+template <class Queue>
+inline void carve(Data<Queue> *data, Arena *arena, int V, int E) {
+    data->cap = data->ownCap ? (int *)arenaAlloc(arena, sizeof(int) * 2 * E) : NULL;
+    data->excess = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->residual = (int *)arenaAlloc(arena, sizeof(int) * 2 * E);
+    data->height = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->current = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->inqueue = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->vertexCnt = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->layer = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->layerNext = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->layerPrev = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->deferred = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->que.carve(arena, V);
+}
+
+// Allocates one arena for graphs of up to V vertices and E edges
+template <class Queue>
+inline Data<Queue> *create(int V, int E, int ncpus, bool ownCap) {
+    Data<Queue> *data = (Data<Queue> *)malloc(sizeof(Data<Queue>));
+    memset(data, 0, sizeof(Data<Queue>));
+    data->ncpus = ncpus;
+    data->que.init(ncpus);
+    data->counters = (Counters *)aligned_alloc(64, sizeof(Counters));
+    memset(data->counters, 0, sizeof(Counters));
+    data->ownCap = ownCap;
+    carve(data, &data->arena, V, E);
+    arenaCommit(&data->arena);
+    carve(data, &data->arena, V, E);
+    data->maxV = V;
+    data->maxE = E;
+    return data;
 }
-}  // namespace PR
-using namespace PR;
 
-void PushRelabel(Graph *graph, int *flow) {
-    Data *data = (Data *)malloc(sizeof(Data));
-    int V = data->V = graph->V;
-    int S = data->S = graph->S;
-    data->T = graph->T;
-    data->ncpus = graph->ncpus;
-    data->edge = (int *)malloc(sizeof(int) * V * V);
-    data->nedge = (int *)malloc(sizeof(int) * V);
-    data->excess = (int *)malloc(sizeof(int) * V);
-    data->residual = (int *)malloc(sizeof(int) * V * V);
-    data->height = (int *)malloc(sizeof(int) * V);
-    data->inqueue = (int *)malloc(sizeof(int) * data->V);
-    data->vertexCnt = (int *)malloc(sizeof(int) * data->V);
-#if QTYPE == 0 || QTYPE == 1 || QTYPE == 2 || QTYPE == 3 || QTYPE == 4
-    data->queue = (int *)malloc(sizeof(int) * (data->V + 1));
-    data->queSize = 0;
-#endif
-#if QTYPE == 0
-    data->queFront = 0;
-    data->queBack = 0;
-#elif QTYPE == 1
-    data->label = data->height;
-#elif QTYPE == 2
-    data->label = (int *)malloc(sizeof(int) * data->V);  // Distance
-#elif QTYPE == 3
-    data->label = (int *)malloc(sizeof(int) * data->V);  // Separates layer
-#elif QTYPE == 4
-    data->label = data->vertexCnt;  // Appearance
-#endif
+// Points data at max flows from S to T on csr, the arena grows if csr does not fit
+template <class Queue>
+inline void bind(Data<Queue> *data, const ResidualGraph *csr, int S, int T) {
+    if (csr->V > data->maxV || csr->E > data->maxE) {
+        arenaFree(&data->arena);
+        data->maxV = csr->V > data->maxV ? csr->V : data->maxV;
+        data->maxE = csr->E > data->maxE ? csr->E : data->maxE;
+        carve(data, &data->arena, data->maxV, data->maxE);
+        arenaCommit(&data->arena);
+        carve(data, &data->arena, data->maxV, data->maxE);
+    }
+    data->V = csr->V;
+    data->S = S;
+    data->T = T;
+    data->csr = csr;
+    if (data->ownCap)
+        memcpy(data->cap, csr->cap, sizeof(int) * 2 * csr->E);
+    else
+        data->cap = csr->cap;
+}
+
+// Zero flow, all vertices inactive
+template <class Queue>
+inline void initialize(Data<Queue> *data) {
+    int V = data->V;
+    const ResidualGraph *csr = data->csr;
+    STATS_THREAD(data->counters);
+    memcpy(data->residual, data->cap, sizeof(int) * 2 * csr->E);
+    for (int u = 0; u < V; u++) {
+        data->excess[u] = 0;
+        data->height[u] = 0;
+        data->inqueue[u] = 0;
+        data->vertexCnt[u] = 0;
+    }
+    data->que.reset(V, data->height, data->vertexCnt);
+    data->work = 0;
+    data->nDeferred = 0;
+    data->workLimit = GLOBAL_RELABEL_FREQ > 0 ? (GLOBAL_RELABEL_ALPHA * (long long)V + 2LL * csr->E) / GLOBAL_RELABEL_FREQ : 0x7fffffffffffffffLL;
+}
+
+template <class Queue>
+inline void preflow(Data<Queue> *data) {
+    const ResidualGraph *csr = data->csr;
+    int S = data->S;
+    data->height[S] = data->V - 1;
+    data->excess[S] = INT_MAX;
+    for (int a = csr->offset[S]; a < csr->offset[S + 1]; a++) {
+        if (data->residual[a] > 0) {
+            push(data, S, a);
+        }
+    }
+}
 
+template <class Queue>
+inline void start(Data<Queue> *data) {
     TIMING_START(_init);
     {
-        for (int u = 0; u < V; u++) {
-            for (int v = 0; v < V; v++) {
-                data->residual[u * V + v] = 0;
-            }
-        }
-        for (int u = 0; u < V; u++) {
-            data->nedge[u] = 0;
-        }
-        for (int u = 0; u < V; u++) {
-            for (int i = 0; i < (int)graph->edge[u].size(); i++) {
-                int v = graph->edge[u][i].first;
-                data->edge[u * V + data->nedge[u]++] = v;
-                data->edge[v * V + data->nedge[v]++] = u;
-                data->residual[u * V + v] = graph->edge[u][i].second;
-            }
-        }
-        for (int u = 0; u < V; u++) {
-            data->excess[u] = 0;
-            data->height[u] = 0;
-            data->inqueue[u] = 0;
-            data->vertexCnt[u] = 0;
-        }
+        initialize(data);
     }
     TIMING_END(_init);
 
     TIMING_START(_shortest_path);
     {
-        shortestPath(data);
+        globalRelabel(data);
     }
     TIMING_END(_shortest_path);
 
-#if QTYPE == 2
-    {
-        for (int u = 0; u < V; u++) {
-            data->label[u] = data->height[u];
-        }
-    }
-#elif QTYPE == 3
-    {
-        std::vector<int> num(V, 0);
-        for (int u = 0; u < V; u++) {
-            data->label[u] = num[data->height[u]]++;
-        }
-    }
-#endif
+    data->que.initLabel();
 
     TIMING_START(_preflow);
     {
-        data->height[S] = V - 1;
-        data->excess[S] = INT_MAX;
-        for (int i = 0; i < data->nedge[S]; i++) {
-            int v = data->edge[S * V + i];
-            if (data->residual[S * V + v] > 0) {
-                push(data, S, v);
-            }
-        }
+        preflow(data);
     }
     TIMING_END(_preflow);
+}
+
+// Phase 1 until the min cut is fixed, then phase 2 back to a flow, see solvePushRelabel
+template <class Queue>
+inline int solve(Data<Queue> *data, int *flow, char *cut) {
+    int V = data->V;
+    int S = data->S;
+    const ResidualGraph *csr = data->csr;
+    STATS_THREAD(data->counters);
+    // Vertices set aside by an earlier cut-only solve of a session are active again
+    for (int k = 0; k < data->nDeferred; k++) {
+        data->que.push(data->deferred[k]);
+    }
+    data->nDeferred = 0;
+    data->phase1 = true;
 
     TIMING_START(_innerPushRelabel);
     {
@@ -297,16 +381,37 @@ void PushRelabel(Graph *graph, int *flow) {
     }
     TIMING_END(_innerPushRelabel);
 
-    TIMING_START(_flow);
-    {
+    if (cut) {
+        TIMING_START(_minCut);
+        // Exact heights, every vertex that cannot reach T is lifted to V
+        globalRelabel(data);
         for (int u = 0; u < V; u++) {
-            for (int i = 0; i < (int)graph->edge[u].size(); i++) {
-                int v = graph->edge[u][i].first;
-                flow[u * V + v] = graph->edge[u][i].second - data->residual[u * V + v];
+            cut[u] = u == S || data->height[u] >= V;
+        }
+        TIMING_END(_minCut);
+    }
+
+    if (flow) {
+        TIMING_START(_returnExcess);
+        {
+            data->phase1 = false;
+            for (int k = 0; k < data->nDeferred; k++) {
+                data->que.push(data->deferred[k]);
+            }
+            data->nDeferred = 0;
+            pushRelabelThread(data);
+        }
+        TIMING_END(_returnExcess);
+
+        TIMING_START(_flow);
+        {
+            for (int i = 0; i < csr->E; i++) {
+                int a = csr->arc[i];
+                flow[i] = data->cap[a] - data->residual[a];
             }
         }
+        TIMING_END(_flow);
     }
-    TIMING_END(_flow);
 
     {
         // Profile
@@ -322,20 +427,237 @@ void PushRelabel(Graph *graph, int *flow) {
         printf(" Max cnt: %d\n", maxcnt);
         printf(" Min cnt: %d\n", mincnt);
         printf(" Max Flow: %d\n", data->excess[data->T]);
+        STATS_MERGE(data->counters, 1);
+        memset(data->counters, 0, sizeof(Counters));
+    }
+    return data->excess[data->T];
+}
+
+// Min s-t cut on the buffers of data without timing or profile output, phase 1
+// only. cut[u] is 1 on the side of s, returns the cut value.
+template <class Queue>
+inline int minCut(Data<Queue> *data, int s, int t, char *cut) {
+    data->S = s;
+    data->T = t;
+    initialize(data);
+    globalRelabel(data);
+    data->que.initLabel();
+    preflow(data);
+    data->phase1 = true;
+    pushRelabelThread(data);
+    globalRelabel(data);
+    for (int u = 0; u < data->V; u++) {
+        cut[u] = u == s || data->height[u] >= data->V;
+    }
+    return data->excess[t];
+}
+
+// Queues u if it holds excess and is not queued yet
+template <class Queue>
+inline void activate(Data<Queue> *data, int u) {
+    if (!data->inqueue[u] && data->excess[u] > 0 && u != data->S && u != data->T) {
+        data->inqueue[u] = 1;
+        data->que.push(u);
+    }
+}
+
+// Sets new capacities and repairs the flow of the last solve into a preflow
+// with valid heights. Flow above a new capacity returns to the tail, and the
+// resulting deficit at the head is pushed forward along arcs that carry flow
+// until it reaches T or S. Heights are only recomputed if some arc that gained
+// residual capacity breaks height[x] <= height[y] + 1.
+template <class Queue>
+inline void update(Data<Queue> *data, int n, const int *edge, const int *cap) {
+    const ResidualGraph *csr = data->csr;
+    int S = data->S;
+    int T = data->T;
+    STATS_THREAD(data->counters);
+    // The queue is empty between solves, so the appearance keys can restart.
+    // Each warm solve schedules global relabels and reports counts of its own.
+    memset(data->vertexCnt, 0, sizeof(int) * data->V);
+    data->work = 0;
+    std::vector<int> touched;  // Arcs that gained residual capacity
+    std::vector<int> deficit;  // Vertices with more outflow than inflow
+    for (int k = 0; k < n; k++) {
+        int a = csr->arc[edge[k]];
+        int r = csr->rev[a];
+        int u = csr->head[r];
+        int v = csr->head[a];
+        int delta = cap[k] - data->cap[a];
+        data->cap[a] = cap[k];
+        data->residual[a] += delta;
+        if (data->residual[a] < 0) {
+            int over = -data->residual[a];
+            data->residual[a] = 0;
+            data->residual[r] -= over;
+            data->excess[u] += over;
+            data->excess[v] -= over;
+            if (v != S && v != T && data->excess[v] < 0 && data->excess[v] + over >= 0)
+                deficit.push_back(v);
+            activate(data, u);
+        } else if (delta > 0) {
+            touched.push_back(a);
+        }
     }
 
-    free(data->edge);
-    free(data->nedge);
-    free(data->excess);
-    free(data->residual);
-    free(data->height);
-    free(data->inqueue);
-    free(data->vertexCnt);
-#if QTYPE == 0 || QTYPE == 1 || QTYPE == 2 || QTYPE == 3 || QTYPE == 4
-    free(data->queue);
-#endif
-#if QTYPE == 2 || QTYPE == 3
-    free(data->label);
-#endif
+    // A vertex with negative excess has an outgoing arc with positive flow
+    while (deficit.size()) {
+        int v = deficit.back();
+        deficit.pop_back();
+        for (int a = csr->offset[v]; data->excess[v] < 0 && a < csr->offset[v + 1]; a++) {
+            int f = data->cap[a] - data->residual[a];
+            if (f <= 0)
+                continue;
+            int w = csr->head[a];
+            int delta = min(f, -data->excess[v]);
+            data->residual[a] += delta;
+            data->residual[csr->rev[a]] -= delta;
+            data->excess[v] += delta;
+            data->excess[w] -= delta;
+            touched.push_back(a);
+            if (w != S && w != T && data->excess[w] < 0 && data->excess[w] + delta >= 0)
+                deficit.push_back(w);
+        }
+    }
+
+    for (int a : touched) {
+        int x = csr->head[csr->rev[a]];
+        if (x != S && data->residual[a] > 0 && data->height[x] > data->height[csr->head[a]] + 1) {
+            globalRelabel(data);
+            break;
+        }
+    }
+
+    // Arcs out of S that became admissible take all they can, as in the preflow
+    for (int a = csr->offset[S]; a < csr->offset[S + 1]; a++) {
+        if (data->residual[a] > 0 && data->height[S] > data->height[csr->head[a]] + 1)
+            push(data, S, a);
+    }
+}
+
+template <class Queue>
+inline void destroy(Data<Queue> *data) {
+    data->que.destroy();
+    free(data->counters);
+    arenaFree(&data->arena);
     free(data);
-}
\ No newline at end of file
+}
+
+// Entry points of one queue specialization. Sessions call them once per solve,
+// everything below them is inlined for that queue.
+struct Ops {
+    void *(*create)(int V, int E, int ncpus, bool ownCap);
+    void (*bind)(void *data, const ResidualGraph *csr, int S, int T);
+    void (*start)(void *data);
+    int (*solve)(void *data, int *flow, char *cut);
+    int (*minCut)(void *data, int s, int t, char *cut);
+    void (*update)(void *data, int n, const int *edge, const int *cap);
+    void (*destroy)(void *data);
+};
+
+template <class Queue>
+struct Engine {
+    static void *create(int V, int E, int ncpus, bool ownCap) {
+        return PR::create<Queue>(V, E, ncpus, ownCap);
+    }
+    static void bind(void *data, const ResidualGraph *csr, int S, int T) {
+        PR::bind((Data<Queue> *)data, csr, S, T);
+    }
+    static void start(void *data) {
+        PR::start((Data<Queue> *)data);
+    }
+    static int solve(void *data, int *flow, char *cut) {
+        return PR::solve((Data<Queue> *)data, flow, cut);
+    }
+    static int minCut(void *data, int s, int t, char *cut) {
+        return PR::minCut((Data<Queue> *)data, s, t, cut);
+    }
+    static void update(void *data, int n, const int *edge, const int *cap) {
+        PR::update((Data<Queue> *)data, n, edge, cap);
+    }
+    static void destroy(void *data) {
+        PR::destroy((Data<Queue> *)data);
+    }
+    static const Ops ops;
+};
+
+template <class Queue>
+const Ops Engine<Queue>::ops = {create, bind, start, solve, minCut, update, destroy};
+
+// With a single thread work stealing is a FIFO and the MultiQueue exact buckets
+inline const Ops *selectOps(int qtype) {
+    switch (qtype) {
+        case 0:
+        case 5:
+            return &Engine<QUE::Fifo>::ops;
+        case 1:
+            return &Engine<QUE::Heap<QUE::HEIGHT>>::ops;
+        case 2:
+            return &Engine<QUE::Heap<QUE::DISTANCE>>::ops;
+        case 3:
+            return &Engine<QUE::Heap<QUE::LAYER>>::ops;
+        case 4:
+            return &Engine<QUE::Heap<QUE::APPEARANCE>>::ops;
+        case 6:
+        case 7:
+            return &Engine<QUE::Buckets>::ops;
+
+        default:
+            fprintf(stderr, "Unknown queue type %d\n", qtype);
+            exit(EXIT_FAILURE);
+    }
+}
+}  // namespace PR
+using namespace PR;
+
+struct PushRelabelSession {
+    const Ops *ops;
+    void *data;
+};
+
+static PushRelabelSession *open(int qtype, int V, int E, int ncpus, bool ownCap) {
+    PushRelabelSession *session = (PushRelabelSession *)malloc(sizeof(PushRelabelSession));
+    session->ops = selectOps(qtype);
+    session->data = session->ops->create(V, E, ncpus, ownCap);
+    return session;
+}
+
+PushRelabelSession *openPushRelabel(Graph *graph) {
+    PushRelabelSession *session = open(graph->qtype, graph->V, graph->E, graph->ncpus, true);
+    session->ops->bind(session->data, &graph->csr, graph->S, graph->T);
+    session->ops->start(session->data);
+    return session;
+}
+
+int solvePushRelabel(PushRelabelSession *session, int *flow, char *cut) {
+    return session->ops->solve(session->data, flow, cut);
+}
+
+PushRelabelSession *openPushRelabel(int V, int E, int ncpus, int qtype) {
+    return open(qtype, V, E, ncpus, false);
+}
+
+int solvePushRelabel(PushRelabelSession *session, Graph *graph, int *flow, char *cut) {
+    session->ops->bind(session->data, &graph->csr, graph->S, graph->T);
+    session->ops->start(session->data);
+    return session->ops->solve(session->data, flow, cut);
+}
+
+void updatePushRelabel(PushRelabelSession *session, int n, const int *edge, const int *cap) {
+    session->ops->update(session->data, n, edge, cap);
+}
+
+void closePushRelabel(PushRelabelSession *session) {
+    session->ops->destroy(session->data);
+    free(session);
+}
+
+PushRelabelSession *openMinCut(const ResidualGraph *csr, int ncpus, int qtype) {
+    PushRelabelSession *session = open(qtype, csr->V, csr->E, ncpus, false);
+    session->ops->bind(session->data, csr, 0, 0);
+    return session;
+}
+
+int solveMinCut(PushRelabelSession *session, int s, int t, char *cut) {
+    return session->ops->minCut(session->data, s, t, cut);
+}
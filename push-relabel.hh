@@ -3,5 +3,27 @@
 
 #include "graph.hh"
 
-void PushRelabel(Graph *graph, int *flow);
+// Cold solves of one graph after another on one arena, sized for up to V vertices
+// and E edges and grown for a larger graph. qtype picks the active vertex queue.
+// Phase 1 stops once no active vertex is below height V, which fixes the min cut,
+// cut is filled then if not NULL. Phase 2 returns the remaining excess to S and
+// fills flow, it is skipped if flow is NULL.
+// Returns the max flow value, known at the end of phase 1.
+struct PushRelabelSession;
+PushRelabelSession *openPushRelabel(int V, int E, int ncpus, int qtype);
+int solvePushRelabel(PushRelabelSession *session, Graph *graph, int *flow, char *cut);
+void closePushRelabel(PushRelabelSession *session);
+
+// Warm-start session on graph->qtype, residual, excess and heights persist between
+// solves so a re-solve after a few capacity changes only works on the affected region
+PushRelabelSession *openPushRelabel(Graph *graph);
+// Solves from the current preflow, flow and cut as in the cold solve
+int solvePushRelabel(PushRelabelSession *session, int *flow, char *cut);
+// Sets the capacity of input edge edge[k] to cap[k], the next solve restores the max flow
+void updatePushRelabel(PushRelabelSession *session, int n, const int *edge, const int *cap);
+
+// Quiet min cuts between any pair of vertices of csr on one set of buffers,
+// for callers that run many max flows. cut[u] is 1 on the side of s.
+PushRelabelSession *openMinCut(const ResidualGraph *csr, int ncpus, int qtype);
+int solveMinCut(PushRelabelSession *session, int s, int t, char *cut);
 #endif  // PUSH_RELABLE
\ No newline at end of file
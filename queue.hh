@@ -0,0 +1,603 @@
+#ifndef QUEUE
+#define QUEUE
+
+#include <sched.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "utility.hh"
+
+// Active vertex queues, one policy per QTYPE, shared by the push-relabel engines.
+// Each policy has the same members so the engines take it as a template parameter:
+//  - carve(arena, V) places the arrays for up to V vertices
+//  - init(ncpus) and destroy() own anything outside the arena, kept across solves
+//  - reset(V, height, vertexCnt) empties the queue for a graph of V vertices,
+//    height and vertexCnt are the engine arrays keys are read from
+//  - initLabel() fixes keys that are taken from the first global relabel
+//  - push(u), pop() (-1 when empty), empty()
+//  - rebuild() restores the order after heights changed under queued vertices
+//  - raise(u, oldHeight) restores it after the height of u alone went up from
+//    oldHeight, nothing happens if u is not queued
+//  - concurrent: push and pop may run on several threads without queLock
+//  - heightKeyed: the order depends on heights, so relabels call rebuild
+#define NUM_QTYPE 8
+
+namespace QUE {
+// Worker index of the calling thread, 0 for the main thread
+static __thread int queId;
+
+inline void swap(int *x, int *y) {
+    int tmp = *x;
+    *x = *y;
+    *y = tmp;
+}
+
+inline int min(int x, int y) {
+    if (x < y)
+        return x;
+    else
+        return y;
+}
+
+// QTYPE 0, first in first out
+struct Fifo {
+    static const bool concurrent = false;
+    static const bool heightKeyed = false;
+    int V;
+    int *queue;
+    int queSize;
+    int queFront;
+    int queBack;
+
+    void carve(Arena *arena, int V) {
+        queue = (int *)arenaAlloc(arena, sizeof(int) * (V + 1));
+    }
+    void init(int) {}
+    void destroy() {}
+    void reset(int V, int *, int *) {
+        this->V = V;
+        queSize = 0;
+        queFront = 0;
+        queBack = 0;
+    }
+    void initLabel() {}
+    void push(int u) {
+        queue[queBack] = u;
+        queBack = (queBack + 1) % V;
+        queSize++;
+    }
+    int pop() {
+        int retVal = -1;
+        if (queSize > 0) {
+            retVal = queue[queFront];
+            queFront = (queFront + 1) % V;
+            queSize--;
+        }
+        return retVal;
+    }
+    bool empty() {
+        return __atomic_load_n(&queSize, __ATOMIC_RELAXED) == 0;
+    }
+    void rebuild() {}
+    void raise(int, int) {}
+};
+
+enum Label {
+    HEIGHT,      // QTYPE 1, current height
+    DISTANCE,    // QTYPE 2, height after the first global relabel
+    LAYER,       // QTYPE 3, separates each layer of the first global relabel
+    APPEARANCE,  // QTYPE 4, times discharged, lowest first
+};
+
+// QTYPE 1 to 4, binary heap on a label, 1-indexed
+template <Label K>
+struct Heap {
+    static const bool concurrent = false;
+    static const bool heightKeyed = K == HEIGHT;
+    int V;
+    int *queue;
+    int queSize;
+    int *label;
+    int *own;  // Label array of DISTANCE and LAYER
+    int *pos;  // Index of each vertex in queue, 0 if not queued, HEIGHT only
+    int *height;
+
+    // a goes before b
+    bool before(int a, int b) {
+        return K == APPEARANCE ? label[a] < label[b] : label[a] > label[b];
+    }
+    void exchange(int i, int j) {
+        swap(&queue[i], &queue[j]);
+        if (K == HEIGHT) {
+            pos[queue[i]] = i;
+            pos[queue[j]] = j;
+        }
+    }
+    void siftUp(int idx) {
+        while (idx > 1 && before(queue[idx], queue[idx / 2])) {
+            exchange(idx, idx / 2);
+            idx = idx / 2;
+        }
+    }
+    void carve(Arena *arena, int V) {
+        queue = (int *)arenaAlloc(arena, sizeof(int) * (V + 1));
+        own = K == DISTANCE || K == LAYER ? (int *)arenaAlloc(arena, sizeof(int) * V) : NULL;
+        pos = K == HEIGHT ? (int *)arenaAlloc(arena, sizeof(int) * V) : NULL;
+    }
+    void init(int) {}
+    void destroy() {}
+    void reset(int V, int *height, int *vertexCnt) {
+        this->V = V;
+        this->height = height;
+        queSize = 0;
+        label = K == HEIGHT ? height : K == APPEARANCE ? vertexCnt : own;
+        if (K == HEIGHT)
+            memset(pos, 0, sizeof(int) * V);
+    }
+    void initLabel() {
+        if (K == DISTANCE) {
+            for (int u = 0; u < V; u++) {
+                label[u] = height[u];
+            }
+        } else if (K == LAYER) {
+            std::vector<int> num(2 * V, 0);  // Heights go up to 2V - 1
+            for (int u = 0; u < V; u++) {
+                label[u] = num[height[u]]++;
+            }
+        }
+    }
+    void push(int u) {
+        queue[++queSize] = u;
+        if (K == HEIGHT)
+            pos[u] = queSize;
+        siftUp(queSize);
+    }
+    int pop() {
+        int retVal = -1;
+        if (queSize > 0) {
+            retVal = queue[1];
+            queue[1] = queue[queSize--];
+            if (K == HEIGHT) {
+                pos[queue[1]] = 1;
+                pos[retVal] = 0;
+            }
+            int idx = 1;
+            while (idx * 2 + 1 <= queSize && (before(queue[idx * 2], queue[idx]) || before(queue[idx * 2 + 1], queue[idx]))) {
+                if (before(queue[idx * 2], queue[idx * 2 + 1])) {
+                    exchange(idx, idx * 2);
+                    idx = idx * 2;
+                } else {
+                    exchange(idx, idx * 2 + 1);
+                    idx = idx * 2 + 1;
+                }
+            }
+            if (idx * 2 <= queSize && before(queue[idx * 2], queue[idx])) {
+                exchange(idx, idx * 2);
+            }
+        }
+        return retVal;
+    }
+    bool empty() {
+        return __atomic_load_n(&queSize, __ATOMIC_RELAXED) == 0;
+    }
+    void rebuild() {
+        if (!heightKeyed)
+            return;
+        int n = queSize;
+        queSize = 0;
+        for (int i = 1; i <= n; i++) {
+            push(queue[i]);
+        }
+    }
+    // A higher label only moves a vertex towards the top
+    void raise(int u, int) {
+        if (K == HEIGHT && pos[u] != 0)
+            siftUp(pos[u]);
+    }
+};
+
+// QTYPE 6, height buckets, highest label first
+struct Buckets {
+    static const bool concurrent = false;
+    static const bool heightKeyed = true;
+    int V;
+    int queSize;
+    int *bucket;      // First active vertex at each height below 2V, -1 if none
+    int *bucketNext;  // Active vertices at one height form a doubly-linked list
+    int *bucketPrev;  // -1 at the head of a bucket, -2 while not in any bucket
+    int maxActive;    // No active vertex is above this height
+    int *height;
+
+    void carve(Arena *arena, int V) {
+        bucket = (int *)arenaAlloc(arena, sizeof(int) * 2 * V);
+        bucketNext = (int *)arenaAlloc(arena, sizeof(int) * V);
+        bucketPrev = (int *)arenaAlloc(arena, sizeof(int) * V);
+    }
+    void init(int) {}
+    void destroy() {}
+    void reset(int V, int *height, int *) {
+        this->V = V;
+        this->height = height;
+        queSize = 0;
+        for (int h = 0; h < 2 * V; h++) {
+            bucket[h] = -1;
+        }
+        for (int u = 0; u < V; u++) {
+            bucketPrev[u] = -2;
+        }
+        maxActive = -1;
+    }
+    void initLabel() {}
+    // h is the height u was pushed at
+    void remove(int u, int h) {
+        int prev = bucketPrev[u];
+        int next = bucketNext[u];
+        if (prev == -1)
+            bucket[min(h, 2 * V - 1)] = next;
+        else
+            bucketNext[prev] = next;
+        if (next != -1)
+            bucketPrev[next] = prev;
+        bucketPrev[u] = -2;
+        queSize--;
+    }
+    // Only an unowned vertex is pushed, so its height is stable until it is popped
+    void push(int u) {
+        int h = min(height[u], 2 * V - 1);
+        bucketPrev[u] = -1;
+        bucketNext[u] = bucket[h];
+        if (bucket[h] != -1)
+            bucketPrev[bucket[h]] = u;
+        bucket[h] = u;
+        if (h > maxActive)
+            maxActive = h;
+        queSize++;
+    }
+    int pop() {
+        while (maxActive >= 0 && bucket[maxActive] == -1)
+            maxActive--;
+        if (maxActive < 0)
+            return -1;
+        int u = bucket[maxActive];
+        remove(u, maxActive);
+        return u;
+    }
+    bool empty() {
+        return __atomic_load_n(&queSize, __ATOMIC_RELAXED) == 0;
+    }
+    // Moves every queued vertex to the bucket of its new height
+    void rebuild() {
+        for (int h = 0; h < 2 * V; h++) {
+            bucket[h] = -1;
+        }
+        maxActive = -1;
+        queSize = 0;
+        for (int u = 0; u < V; u++) {
+            if (bucketPrev[u] != -2)
+                push(u);
+        }
+    }
+    void raise(int u, int oldHeight) {
+        if (bucketPrev[u] == -2)
+            return;
+        remove(u, oldHeight);
+        push(u);
+    }
+};
+
+// Capacity and slots of a deque, swapped in as one pointer so that a thief
+// always indexes the slots with the mask they were allocated for
+struct DequeBuffer {
+    long long mask;  // Capacity - 1, capacity is a power of two
+    int *slot;       // Right behind the header in the same allocation
+};
+
+inline DequeBuffer *dequeBuffer(long long mask) {
+    DequeBuffer *buf = (DequeBuffer *)malloc(sizeof(DequeBuffer) + sizeof(int) * (mask + 1));
+    buf->mask = mask;
+    buf->slot = (int *)(buf + 1);
+    return buf;
+}
+
+// Chase-Lev work-stealing deque. The owner pushes and pops at bottom,
+// thieves take from top. The buffer only grows, retired buffers are kept
+// until destruction because a thief may still be reading them.
+struct Deque {
+    alignas(64) long long top;
+    alignas(64) long long bottom;
+    DequeBuffer *buffer;
+    std::vector<DequeBuffer *> *retired;
+
+    void init() {
+        top = 0;
+        bottom = 0;
+        buffer = dequeBuffer(1023);
+        retired = new std::vector<DequeBuffer *>();
+    }
+    void destroy() {
+        free(buffer);
+        for (DequeBuffer *old : *retired) {
+            free(old);
+        }
+        delete retired;
+    }
+    DequeBuffer *grow(DequeBuffer *buf, long long t, long long b) {
+        DequeBuffer *newBuf = dequeBuffer(buf->mask * 2 + 1);
+        for (long long i = t; i < b; i++) {
+            newBuf->slot[i & newBuf->mask] = buf->slot[i & buf->mask];
+        }
+        retired->push_back(buf);
+        __atomic_store_n(&buffer, newBuf, __ATOMIC_RELEASE);
+        return newBuf;
+    }
+    void push(int u) {
+        long long b = __atomic_load_n(&bottom, __ATOMIC_RELAXED);
+        long long t = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+        DequeBuffer *buf = __atomic_load_n(&buffer, __ATOMIC_RELAXED);
+        if (b - t > buf->mask)
+            buf = grow(buf, t, b);
+        __atomic_store_n(&buf->slot[b & buf->mask], u, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    int pop() {
+        long long b = __atomic_load_n(&bottom, __ATOMIC_RELAXED) - 1;
+        DequeBuffer *buf = __atomic_load_n(&buffer, __ATOMIC_RELAXED);
+        __atomic_store_n(&bottom, b, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        long long t = __atomic_load_n(&top, __ATOMIC_RELAXED);
+        int u = -1;
+        if (t <= b) {
+            u = __atomic_load_n(&buf->slot[b & buf->mask], __ATOMIC_RELAXED);
+            if (t == b) {
+                // Last element, race against thieves
+                if (!__atomic_compare_exchange_n(&top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                    u = -1;
+                __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+            }
+        } else {
+            __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+        }
+        return u;
+    }
+    int steal() {
+        long long t = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        long long b = __atomic_load_n(&bottom, __ATOMIC_ACQUIRE);
+        if (t >= b)
+            return -1;
+        // Mask and slots come from the same snapshot
+        DequeBuffer *buf = __atomic_load_n(&buffer, __ATOMIC_ACQUIRE);
+        int u = __atomic_load_n(&buf->slot[t & buf->mask], __ATOMIC_RELAXED);
+        if (!__atomic_compare_exchange_n(&top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            return -1;
+        return u;
+    }
+};
+
+// QTYPE 5, one deque per worker thread. Newly activated vertices stay on the
+// activating thread, an empty worker steals from the others.
+struct WorkStealing {
+    static const bool concurrent = true;
+    static const bool heightKeyed = false;
+    int ncpus;
+    Deque *deque;
+
+    void carve(Arena *, int) {}
+    void init(int ncpus) {
+        this->ncpus = ncpus;
+        deque = (Deque *)aligned_alloc(64, sizeof(Deque) * ncpus);
+        for (int tid = 0; tid < ncpus; tid++) {
+            deque[tid].init();
+        }
+    }
+    void destroy() {
+        for (int tid = 0; tid < ncpus; tid++) {
+            deque[tid].destroy();
+        }
+        free(deque);
+    }
+    void reset(int, int *, int *) {
+        for (int tid = 0; tid < ncpus; tid++) {
+            deque[tid].top = 0;
+            deque[tid].bottom = 0;
+        }
+    }
+    void initLabel() {}
+    void push(int u) {
+        deque[queId].push(u);
+    }
+    // Own deque first, then steal from the others
+    int pop() {
+        int u = deque[queId].pop();
+        for (int k = 1; u == -1 && k < ncpus; k++) {
+            u = deque[(queId + k) % ncpus].steal();
+        }
+        return u;
+    }
+    bool empty() {
+        for (int tid = 0; tid < ncpus; tid++) {
+            if (__atomic_load_n(&deque[tid].bottom, __ATOMIC_ACQUIRE) > __atomic_load_n(&deque[tid].top, __ATOMIC_ACQUIRE))
+                return false;
+        }
+        return true;
+    }
+    void rebuild() {}
+    void raise(int, int) {}
+};
+
+#ifndef MULTIQUEUE_C
+#define MULTIQUEUE_C 2  // Heaps per worker thread
+#endif
+
+// One heap of the MultiQueue, a max-heap on the height a vertex was pushed at
+struct RelaxedHeap {
+    alignas(64) int lock;  // Try-lock, 0 when free
+    int top;               // Key at the top, -1 when empty, read without the lock
+    int size;
+    int capacity;
+    int *key;  // 1-indexed
+    int *vertex;
+
+    void init() {
+        lock = 0;
+        top = -1;
+        size = 0;
+        capacity = 1024;
+        key = (int *)malloc(sizeof(int) * capacity);
+        vertex = (int *)malloc(sizeof(int) * capacity);
+    }
+    void destroy() {
+        free(key);
+        free(vertex);
+    }
+    // Both heap operations require the lock
+    void insert(int h, int u) {
+        if (size + 1 == capacity) {
+            capacity *= 2;
+            key = (int *)realloc(key, sizeof(int) * capacity);
+            vertex = (int *)realloc(vertex, sizeof(int) * capacity);
+        }
+        int idx = ++size;
+        while (idx > 1 && key[idx / 2] < h) {
+            key[idx] = key[idx / 2];
+            vertex[idx] = vertex[idx / 2];
+            idx = idx / 2;
+        }
+        key[idx] = h;
+        vertex[idx] = u;
+        __atomic_store_n(&top, key[1], __ATOMIC_RELAXED);
+    }
+    int deleteTop() {
+        int retVal = vertex[1];
+        int h = key[size];
+        int u = vertex[size--];
+        int idx = 1;
+        while (idx * 2 <= size) {
+            int child = idx * 2;
+            if (child + 1 <= size && key[child + 1] > key[child])
+                child++;
+            if (key[child] <= h)
+                break;
+            key[idx] = key[child];
+            vertex[idx] = vertex[child];
+            idx = child;
+        }
+        key[idx] = h;
+        vertex[idx] = u;
+        __atomic_store_n(&top, size > 0 ? key[1] : -1, __ATOMIC_RELAXED);
+        return retVal;
+    }
+};
+
+// QTYPE 7, MultiQueue after Rihani, Sanders and Dementiev, "MultiQueues: Simple
+// Relaxed Concurrent Priority Queues". Pushes go to a random heap, pops take the
+// better top of two random heaps, so the order is close to highest label without
+// a global lock.
+static __thread unsigned int queSeed;
+
+inline unsigned int queRandom() {
+    if (queSeed == 0)
+        queSeed = 2654435761u * (queId + 1);
+    queSeed ^= queSeed << 13;
+    queSeed ^= queSeed >> 17;
+    queSeed ^= queSeed << 5;
+    return queSeed;
+}
+
+struct MultiQueue {
+    static const bool concurrent = true;
+    static const bool heightKeyed = true;
+    int nmq;
+    RelaxedHeap *mq;
+    int *height;
+
+    void carve(Arena *, int) {}
+    void init(int ncpus) {
+        nmq = MULTIQUEUE_C * ncpus;
+        mq = (RelaxedHeap *)aligned_alloc(64, sizeof(RelaxedHeap) * nmq);
+        for (int k = 0; k < nmq; k++) {
+            mq[k].init();
+        }
+    }
+    void destroy() {
+        for (int k = 0; k < nmq; k++) {
+            mq[k].destroy();
+        }
+        free(mq);
+    }
+    void reset(int, int *height, int *) {
+        this->height = height;
+        for (int k = 0; k < nmq; k++) {
+            mq[k].size = 0;
+            mq[k].top = -1;
+        }
+    }
+    void initLabel() {}
+    // Only an unowned vertex is pushed, so its height is stable until it is popped
+    void push(int u) {
+        int h = height[u];
+        for (;;) {
+            RelaxedHeap *q = &mq[queRandom() % nmq];
+            if (__sync_lock_test_and_set(&q->lock, 1) == 0) {
+                q->insert(h, u);
+                __sync_lock_release(&q->lock);
+                return;
+            }
+        }
+    }
+    int pop() {
+        for (int attempt = 0; attempt < nmq; attempt++) {
+            RelaxedHeap *p = &mq[queRandom() % nmq];
+            RelaxedHeap *q = &mq[queRandom() % nmq];
+            if (__atomic_load_n(&q->top, __ATOMIC_RELAXED) > __atomic_load_n(&p->top, __ATOMIC_RELAXED))
+                p = q;
+            if (__atomic_load_n(&p->top, __ATOMIC_RELAXED) < 0 || __sync_lock_test_and_set(&p->lock, 1) != 0)
+                continue;
+            int u = p->size > 0 ? p->deleteTop() : -1;
+            __sync_lock_release(&p->lock);
+            if (u != -1)
+                return u;
+        }
+        // Sampling kept missing, look at every heap before reporting empty
+        for (int k = 0; k < nmq; k++) {
+            RelaxedHeap *q = &mq[k];
+            if (__atomic_load_n(&q->top, __ATOMIC_RELAXED) < 0)
+                continue;
+            while (__sync_lock_test_and_set(&q->lock, 1) != 0)
+                sched_yield();
+            int u = q->size > 0 ? q->deleteTop() : -1;
+            __sync_lock_release(&q->lock);
+            if (u != -1)
+                return u;
+        }
+        return -1;
+    }
+    bool empty() {
+        for (int k = 0; k < nmq; k++) {
+            if (__atomic_load_n(&mq[k].top, __ATOMIC_RELAXED) >= 0)
+                return false;
+        }
+        return true;
+    }
+    // Rekeys every heap on the current heights
+    void rebuild() {
+        for (int k = 0; k < nmq; k++) {
+            RelaxedHeap *q = &mq[k];
+            int n = q->size;
+            q->size = 0;
+            q->top = -1;
+            for (int i = 1; i <= n; i++) {
+                int u = q->vertex[i];
+                q->insert(height[u], u);
+            }
+        }
+    }
+    // Finding u would take a scan of every heap, its stale key only costs priority
+    void raise(int, int) {}
+};
+}  // namespace QUE
+
+#endif  // QUEUE
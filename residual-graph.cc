@@ -0,0 +1,92 @@
+#include "residual-graph.hh"
+
+#include <omp.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+void buildResidualGraph(ResidualGraph *csr, int V, int E, const int *tail, const int *head, const int *cap) {
+    if (E < 0 || E > MAX_EDGES) {
+        fprintf(stderr, "%d edges, at most %d are supported\n", E, MAX_EDGES);
+        exit(EXIT_FAILURE);
+    }
+    csr->V = V;
+    csr->E = E;
+    csr->offset = (int *)malloc(sizeof(int) * (V + 1));
+    csr->head = (int *)malloc(sizeof(int) * 2 * E);
+    csr->rev = (int *)malloc(sizeof(int) * 2 * E);
+    csr->cap = (int *)malloc(sizeof(int) * 2 * E);
+    csr->arc = (int *)malloc(sizeof(int) * E);
+    csr->map = NULL;
+    int *pos = (int *)malloc(sizeof(int) * (V + 1));
+    int *rarc = (int *)malloc(sizeof(int) * E);
+
+    // Degree counting, both directions
+#pragma omp parallel for
+    for (int u = 0; u <= V; u++) {
+        csr->offset[u] = 0;
+    }
+#pragma omp parallel for
+    for (int i = 0; i < E; i++) {
+#pragma omp atomic
+        csr->offset[tail[i] + 1]++;
+#pragma omp atomic
+        csr->offset[head[i] + 1]++;
+    }
+    for (int u = 0; u < V; u++) {
+        csr->offset[u + 1] += csr->offset[u];
+    }
+    memcpy(pos, csr->offset, sizeof(int) * V);
+
+    // Scatter keys 2 * i (forward) and 2 * i + 1 (reverse) into rev as scratch
+#pragma omp parallel for
+    for (int i = 0; i < E; i++) {
+        int a, b;
+#pragma omp atomic capture
+        a = pos[tail[i]]++;
+#pragma omp atomic capture
+        b = pos[head[i]]++;
+        csr->rev[a] = 2 * i;
+        csr->rev[b] = 2 * i + 1;
+    }
+
+    // Restore edge order inside each vertex, then resolve arcs from keys
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int u = 0; u < V; u++) {
+        std::sort(csr->rev + csr->offset[u], csr->rev + csr->offset[u + 1]);
+        for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+            int i = csr->rev[a] >> 1;
+            if (csr->rev[a] & 1) {
+                csr->head[a] = tail[i];
+                csr->cap[a] = 0;
+                rarc[i] = a;
+            } else {
+                csr->head[a] = head[i];
+                csr->cap[a] = cap[i];
+                csr->arc[i] = a;
+            }
+        }
+    }
+#pragma omp parallel for
+    for (int i = 0; i < E; i++) {
+        csr->rev[csr->arc[i]] = rarc[i];
+        csr->rev[rarc[i]] = csr->arc[i];
+    }
+    free(pos);
+    free(rarc);
+}
+
+void freeResidualGraph(ResidualGraph *csr) {
+    if (csr->map) {
+        munmap(csr->map, csr->mapSize);
+        return;
+    }
+    free(csr->offset);
+    free(csr->head);
+    free(csr->rev);
+    free(csr->cap);
+    free(csr->arc);
+}
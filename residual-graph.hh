@@ -0,0 +1,28 @@
+#ifndef RESIDUAL_GRAPH
+#define RESIDUAL_GRAPH
+#include <cstddef>
+
+// Arcs and the build's scratch keys 2 * i + 1 are int, which caps the edges
+#define MAX_EDGES 0x3fffffff
+
+// Compressed sparse row residual graph.
+// Every edge (u, v) of the input becomes a pair of arcs u->v and v->u,
+// arcs of u are stored contiguously in [offset[u], offset[u + 1]).
+struct ResidualGraph {
+    int V;        // Number of vertices
+    int E;        // Number of edges, there are 2 * E arcs
+    int *offset;  // Size V + 1
+    int *head;    // Size 2 * E, head vertex of arc
+    int *rev;     // Size 2 * E, index of the paired reverse arc
+    int *cap;     // Size 2 * E, capacity of arc, 0 for reverse arcs
+    int *arc;     // Size E, forward arc of each input edge
+    void *map;    // Read-only snapshot mapping backing the arrays, NULL if malloc'ed
+    size_t mapSize;
+};
+
+// Parallel build from an edge list, edge i is (tail[i], head[i]) with capacity cap[i].
+// Arcs of each vertex are ordered by edge index. Exits if E exceeds MAX_EDGES.
+void buildResidualGraph(ResidualGraph *csr, int V, int E, const int *tail, const int *head, const int *cap);
+void freeResidualGraph(ResidualGraph *csr);
+
+#endif  // RESIDUAL_GRAPH
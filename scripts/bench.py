@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Benchmark matrix for ./main.
+
+Every (V, D) graph is generated once into a snapshot, then each configuration
+of threads, method and queue type solves it --runs times in fresh processes.
+Solve time is the method's TIMING scope from the -s report of main, so graph
+loading and verification are not counted. Reports the median with a
+distribution-free confidence interval and edges per second, writes CSV or
+JSON, and compares against a stored JSON baseline. A run that fails or
+exceeds --timeout fails its configuration, the rest of the matrix still
+runs and the exit status is 1.
+
+  scripts/bench.py --V 2000 4000 --D 5 --threads 1 4 --methods pr ppr --qtypes 0 2 6 \\
+                   --json now.json --baseline before.json
+"""
+
+import argparse
+import csv
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+SCOPE = {
+    "ff": "FordFulkerson",
+    "pr": "PushRelabel",
+    "ppr": "ParallelPushRelabel",
+    "lfppr": "LockFreePushRelabel",
+    "sppr": "SyncPushRelabel",
+}
+QUEUED = ("pr", "ppr", "lfppr")  # Methods with an active vertex queue
+FIELDS = ["V", "D", "E", "threads", "method", "qtype", "runs", "median", "low", "high", "level", "edgesPerSecond"]
+
+
+def median(xs):
+    xs = sorted(xs)
+    n = len(xs)
+    return xs[n // 2] if n % 2 else (xs[n // 2 - 1] + xs[n // 2]) / 2
+
+
+def median_ci(xs, level):
+    """Order statistics (x[j], x[n-1-j]) that cover the median with probability
+    of at least level, from the Binomial(n, 1/2) distribution of the number of
+    samples below it. Returns the narrowest such pair and its actual coverage,
+    the full range if n is too small to reach level."""
+    xs = sorted(xs)
+    n = len(xs)
+    cdf = [0.0] * (n + 1)  # cdf[k] = P(B <= k)
+    total = 0.0
+    for k in range(n + 1):
+        total += math.comb(n, k) / 2**n
+        cdf[k] = total
+    best = (0, 1 - 2 * cdf[0] if n > 0 else 0)
+    for j in range(n // 2):
+        coverage = 1 - 2 * cdf[j]  # P(x[j] <= median <= x[n-1-j])
+        if coverage >= level:
+            best = (j, coverage)
+    j, coverage = best
+    return xs[j], xs[n - 1 - j], coverage
+
+
+class Failure(Exception):
+    pass
+
+
+def run(cmd, env, timeout, verified=True):
+    try:
+        out = subprocess.run(cmd, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, timeout=timeout)
+    except subprocess.TimeoutExpired:
+        raise Failure("Timed out after %gs: %s" % (timeout, " ".join(cmd)))
+    if out.returncode != 0 or (verified and "Passed" not in out.stdout):
+        raise Failure("Failed: %s\n%s" % (" ".join(cmd), out.stdout[-2000:]))
+    return out.stdout
+
+
+def key(row):
+    return "V=%s D=%s threads=%s method=%s qtype=%s" % (row["V"], row["D"], row["threads"], row["method"], row["qtype"])
+
+
+def compare(rows, baseline, threshold):
+    """Regressions are configurations whose median is more than threshold
+    slower than the baseline and whose interval lies above the baseline's."""
+    base = {key(r): r for r in baseline}
+    regressions = 0
+    for row in rows:
+        old = base.get(key(row))
+        if old is None:
+            continue
+        change = row["median"] / old["median"] - 1
+        slower = change > threshold and row["low"] > old["high"]
+        faster = change < -threshold and row["high"] < old["low"]
+        flag = "REGRESSION" if slower else "improved" if faster else ""
+        regressions += slower
+        print("%-60s %10.6fs -> %10.6fs %+7.1f%% %s" % (key(row), old["median"], row["median"], 100 * change, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--V", type=int, nargs="+", default=[2000])
+    parser.add_argument("--D", type=float, nargs="+", default=[5], help="density in percent")
+    parser.add_argument("--threads", type=int, nargs="+", default=[os.cpu_count()])
+    parser.add_argument("--methods", nargs="+", default=["pr", "ppr"], choices=sorted(SCOPE))
+    parser.add_argument("--qtypes", type=int, nargs="+", default=[2], help="only for " + ", ".join(QUEUED))
+    parser.add_argument("--lock", choices=["spin", "mutex"], help="default is the SPINLOCK build flag")
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--warmup", type=int, default=1, help="runs per configuration left out of the statistics")
+    parser.add_argument("--level", type=float, default=0.95, help="confidence level of the median interval")
+    parser.add_argument("--timeout", type=float, default=600, help="seconds before a run counts as failed")
+    parser.add_argument("--main", default="./main")
+    parser.add_argument("--launcher", default="", help='prefix for each run, {threads} is replaced, e.g. "srun -c {threads}"')
+    parser.add_argument("--build", action="store_true", help="make clean && make first")
+    parser.add_argument("--csv")
+    parser.add_argument("--json")
+    parser.add_argument("--baseline", help="JSON written by an earlier --json")
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative slowdown that counts as a regression")
+    args = parser.parse_args()
+
+    if args.build:
+        subprocess.run(["make", "clean"], check=True, stdout=subprocess.DEVNULL)
+        subprocess.run(["make", "-j%d" % os.cpu_count()], check=True, stdout=subprocess.DEVNULL)
+
+    rows = []
+    failed = []
+    with tempfile.TemporaryDirectory() as tmp:
+        report = os.path.join(tmp, "report.json")
+        for V in args.V:
+            for D in args.D:
+                snap = os.path.join(tmp, "graph.snap")
+                try:
+                    run([args.main, "-o", snap, str(V), str(D)], dict(os.environ), args.timeout, verified=False)
+                except Failure as e:
+                    sys.exit(str(e))
+                for threads in args.threads:
+                    env = dict(os.environ, OMP_NUM_THREADS=str(threads))
+                    launcher = args.launcher.format(threads=threads).split()
+                    for method in args.methods:
+                        for qtype in args.qtypes if method in QUEUED else [None]:
+                            cmd = launcher + [args.main, "-m", method, "-s", report, "-f", snap]
+                            if qtype is not None:
+                                cmd += ["-q", str(qtype)]
+                            if args.lock:
+                                cmd += ["-l", args.lock]
+                            config = {"V": V, "D": D, "threads": threads, "method": method, "qtype": qtype}
+                            times = []
+                            try:
+                                for r in range(args.warmup + args.runs):
+                                    run(cmd, env, args.timeout)
+                                    with open(report) as fp:
+                                        stats = json.load(fp)
+                                    if r >= args.warmup:
+                                        times.append(stats["phases"][SCOPE[method]]["seconds"])
+                            except Failure as e:
+                                # The rest of the matrix still runs
+                                failed.append(key(config))
+                                print("%-60s FAILED\n%s" % (key(config), e), flush=True)
+                                continue
+                            mid = median(times)
+                            low, high, level = median_ci(times, args.level)
+                            row = {"V": V, "D": D, "E": stats["E"], "threads": threads, "method": method, "qtype": qtype,
+                                   "runs": args.runs, "median": mid, "low": low, "high": high, "level": level,
+                                   "edgesPerSecond": stats["E"] / mid if mid > 0 else 0}
+                            rows.append(row)
+                            print("%-60s median %10.6fs [%.6f, %.6f] @%.0f%% %12.0f edges/s"
+                                  % (key(row), mid, low, high, 100 * level, row["edgesPerSecond"]), flush=True)
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as fp:
+            writer = csv.DictWriter(fp, fieldnames=FIELDS)
+            writer.writeheader()
+            writer.writerows(rows)
+    if args.json:
+        with open(args.json, "w") as fp:
+            json.dump(rows, fp, indent=1)
+    regressions = 0
+    if args.baseline:
+        with open(args.baseline) as fp:
+            regressions = compare(rows, json.load(fp), args.threshold)
+    if failed:
+        print("Failed configurations:\n  " + "\n  ".join(failed))
+        sys.exit("%d configuration(s) failed" % len(failed))
+    if regressions:
+        sys.exit("%d regression(s) against %s" % (regressions, args.baseline))
+
+
+if __name__ == "__main__":
+    main()
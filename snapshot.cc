@@ -0,0 +1,146 @@
+#include "snapshot.hh"
+
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "utility.hh"
+
+namespace SNAP {
+inline void fail(const char *path, const char *msg) {
+    fprintf(stderr, "%s: %s\n", path, msg);
+    exit(EXIT_FAILURE);
+}
+
+inline size_t align(size_t x) {
+    return (x + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+// Byte offsets of offset, head, rev, cap, arc and the end of file
+inline void layout(int V, int E, size_t *pos) {
+    size_t count[5] = {(size_t)V + 1, 2 * (size_t)E, 2 * (size_t)E, 2 * (size_t)E, (size_t)E};
+    pos[0] = align(sizeof(SnapshotHeader));
+    for (int i = 0; i < 5; i++) {
+        pos[i + 1] = align(pos[i] + sizeof(int) * count[i]);
+    }
+}
+}  // namespace SNAP
+
+bool isSnapshot(const char *path) {
+    char magic[8] = {0};
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+    size_t n = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+    return n == sizeof(magic) && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
+
+void saveSnapshot(const char *path, int S, int T, const ResidualGraph *csr) {
+    using namespace SNAP;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.V = csr->V;
+    header.E = csr->E;
+    header.S = S;
+    header.T = T;
+
+    size_t pos[6];
+    layout(csr->V, csr->E, pos);
+    const int *arrays[5] = {csr->offset, csr->head, csr->rev, csr->cap, csr->arc};
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        fail(path, strerror(errno));
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    size_t count[5] = {(size_t)csr->V + 1, 2 * (size_t)csr->E, 2 * (size_t)csr->E, 2 * (size_t)csr->E, (size_t)csr->E};
+    for (int i = 0; ok && i < 5; i++) {
+        ok = fseek(fp, pos[i], SEEK_SET) == 0 && fwrite(arrays[i], sizeof(int), count[i], fp) == count[i];
+    }
+    // Pad to the full layout size so mapping never reads past the end
+    ok = ok && fflush(fp) == 0 && ftruncate(fileno(fp), pos[5]) == 0;
+    if (fclose(fp) != 0 || !ok)
+        fail(path, "write failed");
+    DEBUG_PRINT("Saved %s: V = %d, E = %d, %zu bytes\n", path, csr->V, csr->E, pos[5]);
+}
+
+void mapSnapshot(const char *path, int *V, int *S, int *T, ResidualGraph *csr) {
+    using namespace SNAP;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        fail(path, strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        fail(path, strerror(errno));
+    size_t size = st.st_size;
+    if (size < sizeof(SnapshotHeader))
+        fail(path, "truncated snapshot");
+    char *base = (char *)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        fail(path, strerror(errno));
+    close(fd);
+
+    const SnapshotHeader *header = (const SnapshotHeader *)base;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0)
+        fail(path, "not a snapshot");
+    if (header->version != SNAPSHOT_VERSION)
+        fail(path, "unsupported snapshot version");
+    int nv = header->V, E = header->E, s = header->S, t = header->T;
+    if (nv <= 0 || E < 0 || s < 0 || t < 0 || s >= nv || t >= nv)
+        fail(path, "invalid vertex or edge count, source or sink");
+    if (s == t)
+        fail(path, "source equals sink");
+    if (E > MAX_EDGES)
+        fail(path, "too many edges");
+    size_t pos[6];
+    layout(nv, E, pos);
+    if (size < pos[5])
+        fail(path, "truncated snapshot");
+
+    // Every index the solvers follow stays inside the mapping
+    const int *offset = (const int *)(base + pos[0]);
+    const int *head = (const int *)(base + pos[1]);
+    const int *rev = (const int *)(base + pos[2]);
+    const int *arc = (const int *)(base + pos[4]);
+    if (offset[0] != 0 || offset[nv] != 2 * E)
+        fail(path, "offsets do not cover 2 * E arcs");
+    int bad = 0;
+#pragma omp parallel for reduction(| : bad)
+    for (int u = 0; u < nv; u++) {
+        bad |= offset[u] > offset[u + 1];
+    }
+    if (bad)
+        fail(path, "offsets are not sorted");
+#pragma omp parallel for reduction(| : bad)
+    for (int a = 0; a < 2 * E; a++) {
+        bad |= head[a] < 0 || head[a] >= nv || rev[a] < 0 || rev[a] >= 2 * E || rev[rev[a]] != a;
+    }
+#pragma omp parallel for reduction(| : bad)
+    for (int i = 0; i < E; i++) {
+        bad |= arc[i] < 0 || arc[i] >= 2 * E;
+    }
+    if (bad)
+        fail(path, "arc out of range");
+
+    *V = header->V;
+    *S = header->S;
+    *T = header->T;
+    csr->V = header->V;
+    csr->E = header->E;
+    csr->offset = (int *)(base + pos[0]);
+    csr->head = (int *)(base + pos[1]);
+    csr->rev = (int *)(base + pos[2]);
+    csr->cap = (int *)(base + pos[3]);
+    csr->arc = (int *)(base + pos[4]);
+    csr->map = base;
+    csr->mapSize = size;
+}
@@ -0,0 +1,28 @@
+#ifndef SNAPSHOT
+#define SNAPSHOT
+
+#include "residual-graph.hh"
+
+// Binary graph snapshot, native byte order:
+//   SnapshotHeader, then offset, head, rev, cap and arc arrays of the
+//   residual graph, each starting on a SNAPSHOT_ALIGN boundary.
+#define SNAPSHOT_MAGIC "PMFSNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGN 64
+
+struct SnapshotHeader {
+    char magic[8];
+    int version;
+    int V;
+    int E;
+    int S;
+    int T;
+    int reserved[9];
+};
+
+bool isSnapshot(const char *path);
+void saveSnapshot(const char *path, int S, int T, const ResidualGraph *csr);
+// Maps the snapshot read-only, csr arrays point into the mapping
+void mapSnapshot(const char *path, int *V, int *S, int *T, ResidualGraph *csr);
+
+#endif  // SNAPSHOT
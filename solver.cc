@@ -0,0 +1,90 @@
+#include "solver.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "utility.hh"
+
+const char *methodName[NUM_METHOD] = {"ff", "pr", "ppr", "lfppr", "sppr"};
+
+Method parseMethod(const char *name) {
+    for (int m = 0; m < NUM_METHOD; m++) {
+        if (strcmp(name, methodName[m]) == 0)
+            return (Method)m;
+    }
+    fprintf(stderr, "Unknown method %s\n", name);
+    exit(EXIT_FAILURE);
+}
+
+Solver::Solver(Method method, int V, int E, int ncpus, int qtype, bool spinLock) {
+    this->method = method;
+    ffSession = NULL;
+    prSession = NULL;
+    pprSession = NULL;
+    spprSession = NULL;
+    switch (method) {
+        case ff:
+            ffSession = openFordFulkerson(V, E);
+            break;
+        case pr:
+            prSession = openPushRelabel(V, E, ncpus, qtype);
+            break;
+        case ppr:
+        case lfppr:
+            pprSession = openParallelPushRelabel(V, E, ncpus, qtype, spinLock, method == lfppr);
+            break;
+        case sppr:
+            spprSession = openSyncPushRelabel(V, E, ncpus);
+            break;
+
+        default:
+            break;
+    }
+}
+
+Solver::~Solver() {
+    if (ffSession)
+        closeFordFulkerson(ffSession);
+    if (prSession)
+        closePushRelabel(prSession);
+    if (pprSession)
+        closeParallelPushRelabel(pprSession);
+    if (spprSession)
+        closeSyncPushRelabel(spprSession);
+}
+
+int Solver::solve(Graph *graph, int *flow, char *cut) {
+    int value = 0;
+    switch (method) {
+        case ff:
+            TIMING_START(FordFulkerson);
+            value = solveFordFulkerson(ffSession, graph, flow);
+            TIMING_END(FordFulkerson);
+            break;
+        case pr:
+            TIMING_START(PushRelabel);
+            value = solvePushRelabel(prSession, graph, flow, cut);
+            TIMING_END(PushRelabel);
+            break;
+        case ppr:
+            TIMING_START(ParallelPushRelabel);
+            value = solveParallelPushRelabel(pprSession, graph, flow, cut);
+            TIMING_END(ParallelPushRelabel);
+            break;
+        case lfppr:
+            TIMING_START(LockFreePushRelabel);
+            value = solveParallelPushRelabel(pprSession, graph, flow, cut);
+            TIMING_END(LockFreePushRelabel);
+            break;
+        case sppr:
+            TIMING_START(SyncPushRelabel);
+            value = solveSyncPushRelabel(spprSession, graph, flow);
+            TIMING_END(SyncPushRelabel);
+            break;
+
+        default:
+            break;
+    }
+    return value;
+}
@@ -0,0 +1,40 @@
+#ifndef SOLVER
+#define SOLVER
+
+#include "ford-fulkerson.hh"
+#include "graph.hh"
+#include "parallel-push-relabel.hh"
+#include "push-relabel.hh"
+#include "sync-push-relabel.hh"
+
+enum Method {
+    ff,
+    pr,
+    ppr,
+    lfppr,
+    sppr,
+    NUM_METHOD,
+};
+extern const char *methodName[NUM_METHOD];
+Method parseMethod(const char *name);
+
+// Max flows of one graph after another with one method. The engine state lives
+// in one arena sized for V vertices and E edges up front, ppr and lfppr also keep
+// their worker threads, so a solve only resets state. A larger graph grows the arena.
+class Solver {
+   public:
+    Method method;
+
+    // qtype and spinLock pick the queue and lock policies of pr, ppr and lfppr
+    Solver(Method method, int V, int E, int ncpus, int qtype, bool spinLock);
+    ~Solver();
+    int solve(Graph *graph, int *flow, char *cut);  // flow and cut as in solvePushRelabel, returns the max flow value
+
+   private:
+    FordFulkersonSession *ffSession;
+    PushRelabelSession *prSession;
+    ParallelPushRelabelSession *pprSession;
+    SyncPushRelabelSession *spprSession;
+};
+
+#endif  // SOLVER
@@ -0,0 +1,85 @@
+#include "stats.hh"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "profile.hh"
+
+#ifdef COUNTERS
+__thread Counters *threadCounters;
+#endif  // COUNTERS
+
+namespace STAT {
+Counters *thread = NULL;  // Merged counters of each thread slot
+int nthread = 0;
+int solves = 0;
+
+const char *counterName[] = {"pushes", "saturatingPushes", "relabels", "discharges", "tryLockFails", "pops", "emptyPolls", "queLockWait"};
+const int NUM_COUNTER = sizeof(Counters) / sizeof(long long);
+
+inline void add(Counters *sum, const Counters *c) {
+    long long *dst = (long long *)sum;
+    const long long *src = (const long long *)c;
+    for (int i = 0; i < NUM_COUNTER; i++) {
+        dst[i] += src[i];
+    }
+}
+
+inline void print(FILE *fp, const Counters *c) {
+    const long long *value = (const long long *)c;
+    fprintf(fp, "{");
+    for (int i = 0; i < NUM_COUNTER; i++) {
+        fprintf(fp, "%s\"%s\": %lld", i ? ", " : "", counterName[i], value[i]);
+    }
+    fprintf(fp, "}");
+}
+}  // namespace STAT
+
+void statsMerge(const Counters *counters, int n) {
+    using namespace STAT;
+    if (n > nthread) {
+        thread = (Counters *)realloc(thread, sizeof(Counters) * n);
+        memset(thread + nthread, 0, sizeof(Counters) * (n - nthread));
+        nthread = n;
+    }
+    for (int k = 0; k < n; k++) {
+        add(&thread[k], &counters[k]);
+    }
+    solves++;
+}
+
+void statsSave(const char *path, const char *method, int V, int E, int ncpus) {
+    using namespace STAT;
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "{\n  \"method\": \"%s\", \"V\": %d, \"E\": %d, \"ncpus\": %d,\n", method, V, E, ncpus);
+    fprintf(fp, "  \"phases\": {");
+    profileJson(fp, "    ");
+    fprintf(fp, "\n  },\n");
+#ifdef COUNTERS
+    Counters total;
+    memset(&total, 0, sizeof(total));
+    for (int k = 0; k < nthread; k++) {
+        add(&total, &thread[k]);
+    }
+    fprintf(fp, "  \"solves\": %d,\n  \"counters\": ", solves);
+    print(fp, &total);
+    fprintf(fp, ",\n  \"threads\": [");
+    for (int k = 0; k < nthread; k++) {
+        fprintf(fp, "%s\n    ", k ? "," : "");
+        print(fp, &thread[k]);
+    }
+    fprintf(fp, "\n  ]\n}\n");
+#else
+    fprintf(fp, "  \"counters\": null,\n  \"threads\": null\n}\n");
+#endif  // COUNTERS
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "%s: write failed\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
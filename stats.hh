@@ -0,0 +1,57 @@
+#ifndef STATS
+#define STATS
+
+#include <ctime>
+
+#include "trace.hh"
+
+// Hot-path event counts of one thread, a cache line each so that no two
+// threads ever write the same line
+struct alignas(64) Counters {
+    long long pushes;
+    long long saturatingPushes;  // Pushes that empty the residual capacity of the arc
+    long long relabels;
+    long long discharges;
+    long long tryLockFails;  // Pushes given up because the head was locked
+    long long pops;          // Vertices taken from the active queue
+    long long emptyPolls;    // Pops and idle checks that found no active vertex
+    long long queLockWait;   // Nanoseconds blocked on the queue lock
+};
+
+// Counter updates compile to nothing without COUNTERS. With it, a thread
+// first points threadCounters at its own slot with STATS_THREAD.
+#ifdef COUNTERS
+extern __thread Counters *threadCounters;
+
+inline long long statsClock() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+#define STATS_THREAD(counters) threadCounters = (counters)
+#define STATS_ADD(field, n) threadCounters->field += (n)
+// Only a contended acquire reads the clock, the wait is traced as well
+#define STATS_ACQUIRE(lock)                                        \
+    do {                                                           \
+        if (!(lock).tryAcquire()) {                                \
+            long long __wait = statsClock();                       \
+            TRACE_ACQUIRE(lock, -1);                               \
+            threadCounters->queLockWait += statsClock() - __wait;  \
+        }                                                          \
+    } while (0)
+#define STATS_MERGE(counters, n) statsMerge(counters, n)
+#else
+#define STATS_THREAD(counters)
+#define STATS_ADD(field, n)
+#define STATS_ACQUIRE(lock) TRACE_ACQUIRE(lock, -1)
+#define STATS_MERGE(counters, n)
+#endif  // COUNTERS
+
+// Process-wide report, filled by the main thread after each solve. Slot k of
+// a solve is added to thread k of the report, so repeated solves add up.
+void statsMerge(const Counters *counters, int n);
+// Writes the TIMING scopes of profile.hh, counter totals and per-thread
+// counters as one JSON object, counters is null in a build without COUNTERS
+void statsSave(const char *path, const char *method, int V, int E, int ncpus);
+#endif  // STATS
@@ -0,0 +1,354 @@
+#include "sync-push-relabel.hh"
+
+#include <omp.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "graph.hh"
+#include "utility.hh"
+
+// Round-based push-relabel in the style of Baumstark, Blelloch and Shun,
+// "Efficient Implementation of a Synchronous Parallel Push-Relabel Algorithm".
+// Every round has a push phase and a relabel phase over the active set, each
+// a parallel loop against heights frozen for the whole phase:
+//  - push: an active u pushes along arcs with height[u] == height[v] + 1,
+//    the reverse arc can not be admissible in the same phase, so every arc
+//    pair has a single writer, and received excess goes to addedExcess
+//  - relabel: vertices left with excess take min residual neighbor + 1,
+//    new heights are written to newHeight and applied in bulk
+// No step depends on the order vertices are processed in, so the flow is
+// the same for any number of threads.
+namespace SPR {
+struct Data {
+    int V;
+    int S;
+    int T;
+    int ncpus;
+    const ResidualGraph *csr;
+    int *excess;
+    int *addedExcess;  // Excess received during the current push phase
+    int *residual;
+    int *height;
+    int *newHeight;
+    int *active;      // Active set of the current round
+    int nactive;
+    int *next;        // Active set of the next round
+    int nnext;
+    int *discovered;  // Already in next
+    int *frontier;    // Global relabel BFS frontiers
+    int *nextFrontier;
+    long long work;       // Relabel work since the last global relabel
+    long long workLimit;  // Global relabel threshold
+    int rounds;
+    int maxV;  // Vertices and edges the arena is carved for
+    int maxE;
+    Arena arena;
+};
+
+inline int min(int x, int y) {
+    if (x < y)
+        return x;
+    else
+        return y;
+}
+
+inline int max(int x, int y) {
+    if (x > y)
+        return x;
+    else
+        return y;
+}
+
+// Labels the unlabeled vertices that reach root in the residual graph with
+// height[root] plus their distance to it, by a level-synchronous parallel BFS
+inline void backwardBfs(Data *data, int root) {
+    const ResidualGraph *csr = data->csr;
+    data->frontier[0] = root;
+    int nfrontier = 1;
+    for (int L = data->height[root]; nfrontier > 0; L++) {
+        int nnext = 0;
+#pragma omp parallel for num_threads(data->ncpus) schedule(dynamic, 64)
+        for (int k = 0; k < nfrontier; k++) {
+            int u = data->frontier[k];
+            for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+                int v = csr->head[a];
+                if (data->height[v] == INT_MAX && data->residual[csr->rev[a]] > 0 && __sync_bool_compare_and_swap(&data->height[v], INT_MAX, L + 1)) {
+                    int idx;
+#pragma omp atomic capture
+                    idx = nnext++;
+                    data->nextFrontier[idx] = v;
+                }
+            }
+        }
+        int *tmp = data->frontier;
+        data->frontier = data->nextFrontier;
+        data->nextFrontier = tmp;
+        nfrontier = nnext;
+    }
+}
+
+// Exact heights from a backward BFS from T on the residual graph. Vertices
+// that cannot reach T take V - 1 plus their distance to S, so that excess
+// on its way back to S is not stranded by repeated global relabels. Once
+// the preflow is out, the rest hold no excess and only have residual arcs
+// among themselves, so lifting them to 2V - 1 keeps every arc valid.
+// S is left untouched.
+inline void globalRelabel(Data *data) {
+    int V = data->V;
+    int S = data->S;
+    int T = data->T;
+    int hS = data->height[S];
+#pragma omp parallel for num_threads(data->ncpus)
+    for (int u = 0; u < V; u++) {
+        data->height[u] = INT_MAX;
+    }
+    data->height[T] = 0;
+    data->height[S] = 0;  // Kept out of the search from T
+    backwardBfs(data, T);
+    data->height[S] = V - 1;
+    backwardBfs(data, S);
+    data->height[S] = hS;
+#pragma omp parallel for num_threads(data->ncpus)
+    for (int u = 0; u < V; u++) {
+        if (data->height[u] == INT_MAX)
+            data->height[u] = 2 * V - 1;
+    }
+    data->work = 0;
+}
+
+// Adds excess to v and puts it in the next active set once
+inline void receive(Data *data, int v, int delta) {
+    if (v == data->S || v == data->T) {
+        __sync_fetch_and_add(&data->excess[v], delta);
+        return;
+    }
+    __sync_fetch_and_add(&data->addedExcess[v], delta);
+    if (__sync_bool_compare_and_swap(&data->discovered[v], 0, 1)) {
+        int idx;
+#pragma omp atomic capture
+        idx = data->nnext++;
+        data->next[idx] = v;
+    }
+}
+
+// Pushes the excess of u along admissible arcs, returns the excess left
+inline int pushPhase(Data *data, int u) {
+    const ResidualGraph *csr = data->csr;
+    int e = data->excess[u];
+    for (int a = csr->offset[u]; e > 0 && a < csr->offset[u + 1]; a++) {
+        int v = csr->head[a];
+        if (data->height[u] == data->height[v] + 1 && data->residual[a] > 0) {
+            int delta = min(e, data->residual[a]);
+            data->residual[a] -= delta;
+            data->residual[csr->rev[a]] += delta;
+            e -= delta;
+            receive(data, v, delta);
+        }
+    }
+    return e;
+}
+
+// Min residual neighbor + 1, unchanged if u still has an admissible arc.
+// Heights are a valid labeling, so this never lowers u.
+inline int relabelPhase(Data *data, int u) {
+    const ResidualGraph *csr = data->csr;
+    int minHeight = INT_MAX;
+    for (int a = csr->offset[u]; a < csr->offset[u + 1]; a++) {
+        if (data->residual[a] > 0)
+            minHeight = min(minHeight, data->height[csr->head[a]]);
+    }
+    if (minHeight == INT_MAX)
+        return data->height[u];
+    assert(minHeight + 1 >= data->height[u]);
+    return max(data->height[u], minHeight + 1);
+}
+
+// Returns the number of vertices that pushed or changed height. An active
+// vertex always does one or the other, so a round without either is a bug.
+inline int pushRelabelRound(Data *data) {
+    const ResidualGraph *csr = data->csr;
+    data->nnext = 0;
+
+    // Push phase
+    int progress = 0;
+#pragma omp parallel for num_threads(data->ncpus) schedule(dynamic, 16) reduction(+ : progress)
+    for (int k = 0; k < data->nactive; k++) {
+        int u = data->active[k];
+        // Only u writes its own excess during the phase, others use addedExcess
+        int e0 = data->excess[u];
+        int e = data->excess[u] = pushPhase(data, u);
+        progress += e != e0;
+        if (e > 0 && __sync_bool_compare_and_swap(&data->discovered[u], 0, 1)) {
+            int idx;
+#pragma omp atomic capture
+            idx = data->nnext++;
+            data->next[idx] = u;
+        }
+    }
+
+    // Apply excess, relabel the vertices that still hold excess
+    long long work = 0;
+#pragma omp parallel for num_threads(data->ncpus) schedule(dynamic, 16) reduction(+ : work, progress)
+    for (int k = 0; k < data->nnext; k++) {
+        int u = data->next[k];
+        data->excess[u] += data->addedExcess[u];
+        data->addedExcess[u] = 0;
+        data->discovered[u] = 0;
+        data->newHeight[u] = relabelPhase(data, u);
+        if (data->newHeight[u] != data->height[u]) {
+            work += GLOBAL_RELABEL_BETA + csr->offset[u + 1] - csr->offset[u];
+            progress++;
+        }
+    }
+#pragma omp parallel for num_threads(data->ncpus)
+    for (int k = 0; k < data->nnext; k++) {
+        int u = data->next[k];
+        data->height[u] = data->newHeight[u];
+    }
+    data->work += work;
+
+    int *tmp = data->active;
+    data->active = data->next;
+    data->next = tmp;
+    data->nactive = data->nnext;
+    data->rounds++;
+    return progress;
+}
+
+inline void carve(Data *data, Arena *arena, int V, int E) {
+    data->excess = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->addedExcess = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->residual = (int *)arenaAlloc(arena, sizeof(int) * 2 * E);
+    data->height = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->newHeight = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->active = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->next = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->discovered = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->frontier = (int *)arenaAlloc(arena, sizeof(int) * V);
+    data->nextFrontier = (int *)arenaAlloc(arena, sizeof(int) * V);
+}
+
+// Grows the arena to fit V vertices and E edges, kept as is if it already does
+inline void reserve(Data *data, int V, int E) {
+    if (data->arena.base && V <= data->maxV && E <= data->maxE)
+        return;
+    V = V > data->maxV ? V : data->maxV;
+    E = E > data->maxE ? E : data->maxE;
+    arenaFree(&data->arena);
+    carve(data, &data->arena, V, E);
+    arenaCommit(&data->arena);
+    carve(data, &data->arena, V, E);
+    data->maxV = V;
+    data->maxE = E;
+}
+}  // namespace SPR
+using namespace SPR;
+
+struct SyncPushRelabelSession {
+    Data *data;
+};
+
+SyncPushRelabelSession *openSyncPushRelabel(int V, int E, int ncpus) {
+    SyncPushRelabelSession *session = (SyncPushRelabelSession *)malloc(sizeof(SyncPushRelabelSession));
+    Data *data = session->data = (Data *)malloc(sizeof(Data));
+    memset(data, 0, sizeof(Data));
+    data->ncpus = ncpus;
+    reserve(data, V, E);
+    return session;
+}
+
+int solveSyncPushRelabel(SyncPushRelabelSession *session, Graph *graph, int *flow) {
+    Data *data = session->data;
+    reserve(data, graph->V, graph->E);
+    int V = data->V = graph->V;
+    int S = data->S = graph->S;
+    data->T = graph->T;
+    const ResidualGraph *csr = data->csr = &graph->csr;
+
+    TIMING_START(_init);
+    {
+        memcpy(data->residual, csr->cap, sizeof(int) * 2 * csr->E);
+#pragma omp parallel for num_threads(data->ncpus)
+        for (int u = 0; u < V; u++) {
+            data->excess[u] = 0;
+            data->addedExcess[u] = 0;
+            data->height[u] = 0;
+            data->discovered[u] = 0;
+        }
+        data->rounds = 0;
+        data->work = 0;
+        data->workLimit = GLOBAL_RELABEL_FREQ > 0 ? (GLOBAL_RELABEL_ALPHA * (long long)V + 2LL * csr->E) / GLOBAL_RELABEL_FREQ : 0x7fffffffffffffffLL;
+    }
+    TIMING_END(_init);
+
+    TIMING_START(_preflow);
+    {
+        data->height[S] = V - 1;
+        data->excess[S] = INT_MAX;
+        data->nnext = 0;
+        for (int a = csr->offset[S]; a < csr->offset[S + 1]; a++) {
+            int delta = min(data->excess[S], data->residual[a]);
+            if (delta > 0) {
+                data->residual[a] -= delta;
+                data->residual[csr->rev[a]] += delta;
+                data->excess[S] -= delta;
+                receive(data, csr->head[a], delta);
+            }
+        }
+        for (int k = 0; k < data->nnext; k++) {
+            int u = data->next[k];
+            data->excess[u] += data->addedExcess[u];
+            data->addedExcess[u] = 0;
+            data->discovered[u] = 0;
+            data->active[k] = u;
+        }
+        data->nactive = data->nnext;
+    }
+    TIMING_END(_preflow);
+
+    // After the preflow, so that the vertices it left excess on are found
+    // from S and no excess sits on a vertex lifted to 2V - 1
+    TIMING_START(_shortest_path);
+    {
+        globalRelabel(data);
+    }
+    TIMING_END(_shortest_path);
+
+    TIMING_START(_innerPushRelabel);
+    {
+        while (data->nactive > 0) {
+            if (pushRelabelRound(data) == 0) {
+                fprintf(stderr, "SyncPushRelabel: no push or relabel in round %d, %d vertices stuck with excess\n", data->rounds, data->nactive);
+                exit(EXIT_FAILURE);
+            }
+            if (data->work > data->workLimit)
+                globalRelabel(data);
+        }
+    }
+    TIMING_END(_innerPushRelabel);
+
+    TIMING_START(_flow);
+    {
+        for (int i = 0; i < csr->E; i++) {
+            int a = csr->arc[i];
+            flow[i] = csr->cap[a] - data->residual[a];
+        }
+    }
+    TIMING_END(_flow);
+
+    {
+        // Profile
+        printf(" Rounds: %d\n", data->rounds);
+        printf(" Max Flow: %d\n", data->excess[data->T]);
+    }
+    return data->excess[data->T];
+}
+
+void closeSyncPushRelabel(SyncPushRelabelSession *session) {
+    arenaFree(&session->data->arena);
+    free(session->data);
+    free(session);
+}
@@ -0,0 +1,13 @@
+#ifndef SYNC_PUSH_RELABLE
+#define SYNC_PUSH_RELABLE
+
+#include "graph.hh"
+
+// Bulk-synchronous push-relabel, identical result for any number of threads.
+// Buffers for graphs of up to V vertices and E edges kept between solves,
+// a larger graph grows them. A solve returns the max flow value.
+struct SyncPushRelabelSession;
+SyncPushRelabelSession *openSyncPushRelabel(int V, int E, int ncpus);
+int solveSyncPushRelabel(SyncPushRelabelSession *session, Graph *graph, int *flow);
+void closeSyncPushRelabel(SyncPushRelabelSession *session);
+#endif  // SYNC_PUSH_RELABLE
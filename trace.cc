@@ -0,0 +1,94 @@
+#include "trace.hh"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define TRACE_MAX_THREADS 1024
+
+#ifdef TRACING
+__thread TraceRing *threadTrace;
+#endif  // TRACING
+
+namespace TRC {
+TraceRing *ring[TRACE_MAX_THREADS];
+
+const char *kindName[] = {"discharge", "lock", "idle", "globalRelabel", "gapRelabel"};
+
+inline long long now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+// traceClock ticks per microsecond, measured against the monotonic clock
+inline double ticksPerUs() {
+    long long ns = now();
+    unsigned long long ticks = traceClock();
+    usleep(20000);
+    return (traceClock() - ticks) * 1000.0 / (now() - ns);
+}
+}  // namespace TRC
+
+TraceRing *traceThread(int tid) {
+    using namespace TRC;
+    if (tid < 0 || tid >= TRACE_MAX_THREADS) {
+        fprintf(stderr, "Trace thread %d out of range\n", tid);
+        exit(EXIT_FAILURE);
+    }
+    if (!ring[tid]) {
+        ring[tid] = (TraceRing *)malloc(sizeof(TraceRing));
+        ring[tid]->count = 0;
+    }
+    return ring[tid];
+}
+
+void traceSave(const char *path, int ncpus) {
+    using namespace TRC;
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    double scale = 1 / ticksPerUs();
+    unsigned long long origin = ~0ULL;
+    long long dropped = 0;
+    for (int tid = 0; tid < TRACE_MAX_THREADS; tid++) {
+        if (!ring[tid])
+            continue;
+        long long first = ring[tid]->count > TRACE_EVENTS ? ring[tid]->count - TRACE_EVENTS : 0;
+        for (long long i = first; i < ring[tid]->count; i++) {
+            unsigned long long begin = ring[tid]->event[i & (TRACE_EVENTS - 1)].begin;
+            origin = begin < origin ? begin : origin;
+        }
+        dropped += first;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"otherData\": {\"droppedEvents\": %lld},\n\"traceEvents\": [\n", dropped);
+    bool comma = false;
+    for (int tid = 0; tid < TRACE_MAX_THREADS; tid++) {
+        if (!ring[tid])
+            continue;
+        if (tid < ncpus)
+            fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"worker %d\"}}", comma ? ",\n" : "", tid, tid);
+        else
+            fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"main\"}}", comma ? ",\n" : "", tid);
+        comma = true;
+        long long first = ring[tid]->count > TRACE_EVENTS ? ring[tid]->count - TRACE_EVENTS : 0;
+        for (long long i = first; i < ring[tid]->count; i++) {
+            const TraceEvent *e = &ring[tid]->event[i & (TRACE_EVENTS - 1)];
+            fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f", kindName[e->kind], tid, (e->begin - origin) * scale, (e->end - e->begin) * scale);
+            if (e->vertex >= 0)
+                fprintf(fp, ", \"args\": {\"vertex\": %d}", e->vertex);
+            fprintf(fp, "}");
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "%s: write failed\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef TRACE
+#define TRACE
+
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Events kept per thread, older ones are overwritten. A power of 2.
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS (1 << 18)
+#endif
+
+enum TraceKind { TRACE_DISCHARGE, TRACE_LOCK, TRACE_IDLE, TRACE_GLOBAL_RELABEL, TRACE_GAP_RELABEL };
+
+// One interval, begin and end in traceClock ticks
+struct TraceEvent {
+    unsigned long long begin;
+    unsigned long long end;
+    int kind;
+    int vertex;  // -1 if the event is not about one vertex
+};
+
+struct TraceRing {
+    long long count;  // Events ever recorded, the last TRACE_EVENTS are kept
+    TraceEvent event[TRACE_EVENTS];
+};
+
+// TSC where there is one, so an event costs two counter reads and one store
+inline unsigned long long traceClock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+#endif
+}
+
+// Events compile to nothing without TRACING. With it, a thread first takes
+// its ring with TRACE_THREAD, tid k shows up as thread k of the trace.
+#ifdef TRACING
+extern __thread TraceRing *threadTrace;
+
+inline void traceEvent(int kind, int vertex, unsigned long long begin) {
+    TraceEvent *e = &threadTrace->event[threadTrace->count++ & (TRACE_EVENTS - 1)];
+    e->begin = begin;
+    e->end = traceClock();
+    e->kind = kind;
+    e->vertex = vertex;
+}
+
+#define TRACE_THREAD(tid) threadTrace = traceThread(tid)
+#define TRACE_BEGIN(name) unsigned long long __trace_##name = traceClock()
+#define TRACE_END(name, kind, vertex) traceEvent(kind, vertex, __trace_##name)
+// Only a contended acquire is recorded
+#define TRACE_ACQUIRE(lock, vertex)                            \
+    do {                                                       \
+        if (!(lock).tryAcquire()) {                            \
+            unsigned long long __begin = traceClock();         \
+            (lock).acquire();                                  \
+            traceEvent(TRACE_LOCK, vertex, __begin);           \
+        }                                                      \
+    } while (0)
+#else
+#define TRACE_THREAD(tid)
+#define TRACE_BEGIN(name)
+#define TRACE_END(name, kind, vertex)
+#define TRACE_ACQUIRE(lock, vertex) (lock).acquire()
+#endif  // TRACING
+
+// Ring of thread tid, allocated on first use and kept for the whole process
+TraceRing *traceThread(int tid);
+// Writes the kept events of all threads as a Chrome trace, which Perfetto
+// and chrome://tracing open. Times are microseconds from the first event.
+void traceSave(const char *path, int ncpus);
+#endif  // TRACE
@@ -1,6 +1,7 @@
 #include "utility.hh"
 
 #include <cstdio>
+#include <cstdlib>
 
 void print(int V, int *A) {
     for (int r = 0; r < V; r++) {
@@ -9,4 +10,22 @@ void print(int V, int *A) {
         }
         printf("\n");
     }
-}
\ No newline at end of file
+}
+void *arenaAlloc(Arena *arena, size_t bytes) {
+    void *ptr = arena->base ? arena->base + arena->used : NULL;
+    arena->used += (bytes + 63) / 64 * 64;
+    return ptr;
+}
+
+void arenaCommit(Arena *arena) {
+    arena->size = arena->used;
+    arena->base = (char *)aligned_alloc(64, arena->size > 0 ? arena->size : 64);
+    arena->used = 0;
+}
+
+void arenaFree(Arena *arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
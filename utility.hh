@@ -1,33 +1,20 @@
 #ifndef UTILITY
 #define UTILITY
 
+#include <cstddef>
+
+#include "profile.hh"
+
 #ifdef DEBUG
 #define DEBUG_PRINT(fmt, args...) fprintf(stderr, fmt, ##args);
 #else
 #define DEBUG_PRINT(fmt, args...)
 #endif  // DEBUG
 
+// Wall time of a phase, printed and kept in the profile registry, see profile.hh
 #ifdef TIMING
-#include <ctime>
-#define TIMING_START(arg)          \
-    struct timespec __start_##arg; \
-    clock_gettime(CLOCK_MONOTONIC, &__start_##arg);
-#define TIMING_END(arg)                                                                       \
-    {                                                                                         \
-        struct timespec __temp_##arg, __end_##arg;                                            \
-        double __duration_##arg;                                                              \
-        clock_gettime(CLOCK_MONOTONIC, &__end_##arg);                                         \
-        if ((__end_##arg.tv_nsec - __start_##arg.tv_nsec) < 0) {                              \
-            __temp_##arg.tv_sec = __end_##arg.tv_sec - __start_##arg.tv_sec - 1;              \
-            __temp_##arg.tv_nsec = 1000000000 + __end_##arg.tv_nsec - __start_##arg.tv_nsec;  \
-        } else {                                                                              \
-            __temp_##arg.tv_sec = __end_##arg.tv_sec - __start_##arg.tv_sec;                  \
-            __temp_##arg.tv_nsec = __end_##arg.tv_nsec - __start_##arg.tv_nsec;               \
-        }                                                                                     \
-        __duration_##arg = __temp_##arg.tv_sec + (double)__temp_##arg.tv_nsec / 1000000000.0; \
-        printf("%s took %lfs.\n", #arg, __duration_##arg);                                    \
-        fflush(stdout);                                                                       \
-    }
+#define TIMING_START(arg) profileStart(#arg);
+#define TIMING_END(arg) profileEnd(#arg);
 #else
 #define TIMING_START(arg)
 #define TIMING_END(arg)
@@ -35,6 +22,26 @@
 
 #define INT_MAX 0x7fffffff
 
+// Push-relabel engines rerun the backward BFS from T once the relabel work
+// since the last one exceeds (ALPHA * V + 2 * E) / GLOBAL_RELABEL_FREQ, 0 disables
+#ifndef GLOBAL_RELABEL_FREQ
+#define GLOBAL_RELABEL_FREQ 0.5
+#endif
+#define GLOBAL_RELABEL_ALPHA 6
+#define GLOBAL_RELABEL_BETA 12
+
 void print(int V, int *residual);
 
+// One allocation carved into 64-byte aligned arrays. Carving on an arena with no
+// base only adds up the bytes, so a solver runs the same carve twice: once to
+// size the arena, and once on the committed block to place its arrays.
+struct Arena {
+    char *base;
+    size_t size;
+    size_t used;
+};
+void *arenaAlloc(Arena *arena, size_t bytes);
+void arenaCommit(Arena *arena);  // Allocates the bytes counted so far and starts over at the front
+void arenaFree(Arena *arena);    // Back to an empty sizing arena
+
 #endif  // UTILITY